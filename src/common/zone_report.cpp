@@ -0,0 +1,133 @@
+/*
+ * MIT License
+Copyright (c) 2021 - current
+Authors:  Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "zone_report.h"
+
+extern "C" {
+
+int ss_zone_size(int fd, uint32_t nsid, uint64_t *zone_size) {
+    struct nvme_id_ns ns{};
+    struct nvme_zns_id_ns zns_ns{};
+    int ret = nvme_identify_ns(fd, nsid, &ns);
+    if (ret != 0) {
+        printf("ERROR: failed to identify the namespace %d \n", ret);
+        return ret;
+    }
+    ret = nvme_zns_identify_ns(fd, nsid, &zns_ns);
+    if (ret != 0) {
+        printf("ERROR: failed to identify the ZNS namespace %d \n", ret);
+        return ret;
+    }
+    *zone_size = le64_to_cpu(zns_ns.lbafe[(ns.flbas & 0xf)].zsze);
+    return 0;
+}
+
+static int ss_zone_report_fetch(struct ss_zone_report_iter *iter) {
+    uint32_t report_size = sizeof(struct nvme_zone_report) + (iter->chunk_zones * sizeof(struct nvme_zns_desc));
+    memset(iter->report, 0, report_size);
+    // partial report off: nr_zones counts all zones from next_slba to the end, not only the returned ones
+    int ret = nvme_zns_mgmt_recv(iter->fd, iter->nsid, iter->next_slba,
+                                 NVME_ZNS_ZRA_REPORT_ZONES, NVME_ZNS_ZRAS_REPORT_ALL,
+                                 false, report_size, (void *)iter->report);
+    if (ret != 0) {
+        printf("ERROR: failed to report zones from slba 0x%lx, ret %d \n", iter->next_slba, ret);
+        return ret;
+    }
+    iter->zones_left = le64_to_cpu(iter->report->nr_zones);
+    if (iter->nr_zones == 0) {
+        iter->nr_zones = iter->zones_left;
+    }
+    iter->in_chunk = (uint32_t) std::min<uint64_t>(iter->zones_left, iter->chunk_zones);
+    iter->pos = 0;
+    if (iter->in_chunk > 0) {
+        iter->next_slba = le64_to_cpu(iter->report->entries[iter->in_chunk - 1].zslba) + iter->zone_size;
+    }
+    return 0;
+}
+
+int ss_zone_report_iter_init(struct ss_zone_report_iter *iter, int fd, uint32_t nsid, uint32_t chunk_zones) {
+    memset(iter, 0, sizeof(*iter));
+    iter->fd = fd;
+    iter->nsid = nsid;
+    iter->chunk_zones = chunk_zones == 0 ? SS_ZONE_REPORT_CHUNK : chunk_zones;
+    int ret = ss_zone_size(fd, nsid, &iter->zone_size);
+    if (ret != 0) {
+        return ret;
+    }
+    iter->report = (struct nvme_zone_report *) calloc(1, sizeof(struct nvme_zone_report) + (iter->chunk_zones * sizeof(struct nvme_zns_desc)));
+    if (iter->report == nullptr) {
+        return -ENOMEM;
+    }
+    return ss_zone_report_fetch(iter);
+}
+
+int ss_zone_report_iter_next(struct ss_zone_report_iter *iter, struct nvme_zns_desc **desc) {
+    if (iter->pos == iter->in_chunk) {
+        // the last chunk was the tail of the namespace
+        if (iter->zones_left <= iter->in_chunk) {
+            *desc = nullptr;
+            return 0;
+        }
+        int ret = ss_zone_report_fetch(iter);
+        if (ret != 0) {
+            *desc = nullptr;
+            return ret;
+        }
+        if (iter->in_chunk == 0) {
+            *desc = nullptr;
+            return 0;
+        }
+    }
+    *desc = &iter->report->entries[iter->pos++];
+    return 0;
+}
+
+void ss_zone_report_iter_free(struct ss_zone_report_iter *iter) {
+    free(iter->report);
+    iter->report = nullptr;
+}
+
+int ss_zone_report_single(int fd, uint32_t nsid, uint64_t zone_index, struct nvme_zns_desc *desc) {
+    uint64_t zone_size;
+    char buf[sizeof(struct nvme_zone_report) + sizeof(struct nvme_zns_desc)] = {0};
+    int ret = ss_zone_size(fd, nsid, &zone_size);
+    if (ret != 0) {
+        return ret;
+    }
+    ret = nvme_zns_mgmt_recv(fd, nsid, zone_index * zone_size,
+                             NVME_ZNS_ZRA_REPORT_ZONES, NVME_ZNS_ZRAS_REPORT_ALL,
+                             true, sizeof(buf), (void *)buf);
+    if (ret != 0) {
+        printf("ERROR: failed to report zone %lu, ret %d \n", zone_index, ret);
+        return ret;
+    }
+    memcpy(desc, &((struct nvme_zone_report *)buf)->entries[0], sizeof(*desc));
+    return 0;
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+ * MIT License
+Copyright (c) 2021 - current
+Authors:  Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#ifndef STOSYS_PROJECT_ZONE_REPORT_H
+#define STOSYS_PROJECT_ZONE_REPORT_H
+
+#include <cstdint>
+#include <libnvme.h>
+
+// number of zone descriptors fetched per report command by default (64 bytes each, so 16kB + header)
+#define SS_ZONE_REPORT_CHUNK 256
+
+extern "C" {
+/*
+ * Paginated zone report. Instead of one buffer holding the descriptors of all zones, the iterator
+ * fetches chunk_zones descriptors at a time, starting at successive zslba values, and hands them out
+ * one by one. Memory use is bounded by the chunk size regardless of the number of zones.
+ *
+ *   struct ss_zone_report_iter iter{};
+ *   struct nvme_zns_desc *desc;
+ *   ret = ss_zone_report_iter_init(&iter, fd, nsid, SS_ZONE_REPORT_CHUNK);
+ *   while (ret == 0 && (ret = ss_zone_report_iter_next(&iter, &desc)) == 0 && desc != nullptr) { ... }
+ *   ss_zone_report_iter_free(&iter);
+ */
+struct ss_zone_report_iter {
+    int fd;
+    uint32_t nsid;
+    // zone size in LBAs, the distance between the zslba of two neighbouring zones
+    uint64_t zone_size;
+    uint32_t chunk_zones;
+    struct nvme_zone_report *report;
+    // where the next chunk starts
+    uint64_t next_slba;
+    // descriptors in the current chunk, and the next one to hand out
+    uint32_t in_chunk, pos;
+    // zones from the start of the current chunk to the end of the namespace
+    uint64_t zones_left;
+    // total zones in the namespace, known after the first chunk
+    uint64_t nr_zones;
+};
+
+int ss_zone_report_iter_init(struct ss_zone_report_iter *iter, int fd, uint32_t nsid, uint32_t chunk_zones);
+// sets *desc to the next descriptor, or to nullptr once all zones are seen. Non-zero is an NVMe error
+int ss_zone_report_iter_next(struct ss_zone_report_iter *iter, struct nvme_zns_desc **desc);
+void ss_zone_report_iter_free(struct ss_zone_report_iter *iter);
+
+// zone size in LBAs of the namespace, from the ZNS identify namespace data
+int ss_zone_size(int fd, uint32_t nsid, uint64_t *zone_size);
+// fetch only the descriptor of the zone_index-th zone
+int ss_zone_report_single(int fd, uint32_t nsid, uint64_t zone_index, struct nvme_zns_desc *desc);
+}
+
+#endif //STOSYS_PROJECT_ZONE_REPORT_H
@@ -27,6 +27,7 @@ SOFTWARE.
 
 #include "device.h"
 #include "../common/nvmeprint.h"
+#include "../common/zone_report.h"
 
 // Examples lifted from, https://github.com/linux-nvme/libnvme/blob/667334ff8c53dbbefa51948bbe2e086624bf4d0d/test/cpp.cc
 int count_and_show_all_nvme_devices() {
@@ -128,16 +129,16 @@ int scan_and_identify_zns_devices(struct ss_nvme_ns *list){
     return 0;
 }
 
-int get_zns_zone_status(int fd, int nsid, char* &zone_reports){
+int get_zns_zone_status(int fd, int nsid, uint64_t &num_zones){
     // ZNS specific data structures as specified in the TP 4053
     struct nvme_zns_id_ns s_zns_nsid{};
     struct nvme_zns_id_ctrl s_zns_ctrlid{};
     struct nvme_zone_report zns_report{};
     struct nvme_zns_desc *desc = NULL;
+    struct ss_zone_report_iter iter{};
     // standard NVMe structures
     struct nvme_id_ns s_nsid;
     int ret;
-    uint64_t num_zones;
     // lets first get the NVMe ns identify structure (again), we need some information from it to complement the
     // information present in the ZNS ns identify structure
     ret = nvme_identify_ns(fd, nsid, &s_nsid);
@@ -171,7 +172,7 @@ int get_zns_zone_status(int fd, int nsid, char* &zone_reports){
 
     // Pay attention what is being passed in the zns_report pointer and size, I am passing a structure
     // _WITHOUT_ its entries[] field initialized because we do not know how many zones does this namespace
-    // hence we first get the number of zones, and then try again to get the full report
+    // hence we first get the number of zones
     ret = nvme_zns_mgmt_recv(fd, nsid, 0,
                              NVME_ZNS_ZRA_REPORT_ZONES, NVME_ZNS_ZRAS_REPORT_ALL,
                              0, sizeof(zns_report), (void *)&zns_report);
@@ -182,32 +183,26 @@ int get_zns_zone_status(int fd, int nsid, char* &zone_reports){
     // see figures 37-38-39 in section 4.4.1
     num_zones = le64_to_cpu(zns_report.nr_zones);
     printf("nr_zones:%" PRIu64"\n", num_zones);
-    // lets get more information about the zones - the total metadata size would be
-    // see the figure 37 in the ZNS description
-    // so we allocated an structure with a flat memory and point the zone_reports to it
-    // An alternate strategy would have been just allocate a 4kB page and get some numbers of zone reports whatever can
-    // fit in that in a loop.
-    uint64_t total_size = sizeof(zns_report) + (num_zones * sizeof(struct nvme_zns_desc));
-    zone_reports = (char*) calloc (1, total_size);
-    ret = nvme_zns_mgmt_recv(fd, nsid, 0,
-                             NVME_ZNS_ZRA_REPORT_ZONES, NVME_ZNS_ZRAS_REPORT_ALL,
-                             1, total_size, (void *)zone_reports);
-    if(ret !=0) {
-        fprintf(stderr, "failed to report zones, ret %d \n", ret);
-        return ret;
-    }
-    desc = ((struct nvme_zone_report*) zone_reports)->entries;
-    num_zones = le64_to_cpu(((struct nvme_zone_report*) zone_reports)->nr_zones);
-    // otherwise we got all our reports, check again
-    printf("With the reports we have num_zones %lu (for which data transfer happened) \n", num_zones);
-    for(uint64_t i = 0; i < num_zones; i++){
+    // lets get more information about the zones - rather than one flat buffer with room for every zone descriptor
+    // (see the figure 37 in the ZNS description), which gets large on devices with tens of thousands of zones,
+    // we walk the zones in fixed-size chunks and print them as they come in
+    ret = ss_zone_report_iter_init(&iter, fd, nsid, SS_ZONE_REPORT_CHUNK);
+    uint64_t seen = 0;
+    while (ret == 0 && (ret = ss_zone_report_iter_next(&iter, &desc)) == 0 && desc != NULL) {
         // see figure 39 for description of these fields
         printf("\t SLBA: 0x%-8" PRIx64" WP: 0x%-8" PRIx64" Cap: 0x%-8" PRIx64" State: %-12s Type: %-14s Attrs: 0x%-x\n",
                (uint64_t)le64_to_cpu(desc->zslba), (uint64_t)le64_to_cpu(desc->wp),
                (uint64_t)le64_to_cpu(desc->zcap), ss_zone_state_to_string(desc->zs >> 4),
-               ss_zone_type_to_string(desc->zt), desc->za);                       
-        desc++;
-    }        
+               ss_zone_type_to_string(desc->zt), desc->za);
+        seen++;
+    }
+    ss_zone_report_iter_free(&iter);
+    if(ret != 0) {
+        fprintf(stderr, "failed to report zones, ret %d \n", ret);
+        return ret;
+    }
+    // otherwise we got all our reports, check again
+    printf("With the reports we have num_zones %lu (for which data transfer happened) \n", seen);
     return ret;
 }
 }
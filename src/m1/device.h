@@ -43,7 +43,7 @@ struct zone_to_test {
 // these three function examples are given to you
 int count_and_show_all_nvme_devices();
 int scan_and_identify_zns_devices(struct ss_nvme_ns *list);
-int get_zns_zone_status(int fd, int nsid, char* &ptr);
+int get_zns_zone_status(int fd, int nsid, uint64_t &num_zones);
 
 }
 
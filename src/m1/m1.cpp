@@ -41,6 +41,7 @@ SOFTWARE.
 
 #include "../common/nvmeprint.h"
 #include "../common/utils.h"
+#include "../common/zone_report.h"
 
 extern "C" {
 
@@ -299,8 +300,7 @@ int main(int argc, char **argv) {
     struct ss_nvme_ns *my_devices, *zns_device;
     struct nvme_id_ns ns{};
     struct zone_to_test ztest{};
-    char *zone_report_buffer = nullptr;
-    struct nvme_zone_report* zone_reports_ptr = nullptr;
+    uint64_t num_zones = 0;
 
     printf("===================================================================================== \n");
     printf("This is M1. The goal of this milestone is to explore the framework \n");
@@ -385,27 +385,32 @@ int main(int argc, char **argv) {
     ztest.lba_size_in_use = 1 << ns.lbaf[(ns.flbas & 0xf)].ds;
     printf("the LBA size is %lu bytes \n", ztest.lba_size_in_use);
     // this function shows the zone status and then return the first empty zone to do experiments on in ztest
-    ret = get_zns_zone_status(fd, nsid, zone_report_buffer);
+    ret = get_zns_zone_status(fd, nsid, num_zones);
     if ( ret != 0) {
         printf("failed to get a workable zone, ret %d \n", ret);
         return ret;        
     }
-    // assign the pointer 
-    zone_reports_ptr = (nvme_zone_report*) zone_report_buffer;
-    int num_zones = le64_to_cpu(zone_reports_ptr->nr_zones);    
     // now we have all the zone information, lets set up testing parameters 
     srand((unsigned) time(NULL));
     // Get a random number between 0 - num_zones 
 	int target_zone_index = (rand() % num_zones);
-    printf("Number of working zones in this namespace (nsid %d) are %d (going to choose one randomly for testing = %d) \n", nsid, num_zones, target_zone_index);
-    // copy the content, we do the endiness convertion in the functions 
+    printf("Number of working zones in this namespace (nsid %d) are %lu (going to choose one randomly for testing = %d) \n", nsid, num_zones, target_zone_index);
+    // fetch just the descriptor of that zone, we do the endiness convertion in the functions 
     // LBA size in use is attached to a namespace, which is initialized previosuly 
-    memcpy(&ztest.desc, &(zone_reports_ptr->entries[target_zone_index]), sizeof(*(zone_reports_ptr->entries)));
+    ret = ss_zone_report_single(fd, nsid, target_zone_index, &ztest.desc);
+    if (ret != 0) {
+        printf("failed to get the zone descriptor, ret %d \n", ret);
+        return ret;
+    }
 
     t1 = test1_lba_io_test(fd, nsid, &ztest);
 
     target_zone_index = (rand() % num_zones);    
-    memcpy(&ztest.desc, &zone_reports_ptr[target_zone_index], sizeof(*zone_reports_ptr));
+    ret = ss_zone_report_single(fd, nsid, target_zone_index, &ztest.desc);
+    if (ret != 0) {
+        printf("failed to get the zone descriptor, ret %d \n", ret);
+        return ret;
+    }
 
     t2 = test2_zone_full_io_test(fd, nsid, &ztest);
     
@@ -418,10 +423,6 @@ int main(int argc, char **argv) {
     //printf("Test 3 (multi-threaded I/O)     : %s \n", (t3 == 0 ? " Passed" : " Failed"));
     printf("====================================================================\n");
 
-    if(zone_report_buffer){    
-        free(zone_report_buffer);
-    }
-
     for(int i = 0; i < num_devices; i++) {
         if(my_devices[i].ctrl_name){
             free(my_devices[i].ctrl_name);
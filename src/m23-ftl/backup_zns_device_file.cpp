@@ -26,6 +26,7 @@ SOFTWARE.
 
 #include <cstdlib>
 #include <stdio.h>
+#include <string.h>
 #include <cerrno>
 #include <libnvme.h>
 #include "zns_device.h"
@@ -164,11 +165,51 @@ extern "C" {
         return 0;
     }
 
+    int zns_udevice_write_hint(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size, int hint) {
+        // a plain file keeps no log to sort by lifetime
+        return zns_udevice_write(my_dev, address, buffer, size);
+    }
+
+    int zns_udevice_trim(struct user_zns_device *my_dev, uint64_t address, uint64_t size) {
+        if (address + size > my_dev->capacity_bytes) {
+            printf("ERROR: trim request is outside the device capacity \n");
+            return -EINVAL;
+        }
+        if (address % my_dev->lba_size_bytes != 0 || size % my_dev->lba_size_bytes != 0) {
+            printf("ERROR: trim request is not block aligned \n");
+            return -EINVAL;
+        }
+
+        // a plain file has nothing to give back, the range just reads back as zeroes
+        FILE *fp = (FILE *)(my_dev->_private);
+        char *zeroes = (char *)calloc(1, my_dev->lba_size_bytes);
+        int ret = fseek(fp, address, SEEK_SET);
+        for (uint64_t done = 0; ret == 0 && done < size; done += my_dev->lba_size_bytes) {
+            if (fwrite(zeroes, 1, my_dev->lba_size_bytes, fp) < my_dev->lba_size_bytes) {
+                printf("ERROR: failed to trim address %lu \n", address + done);
+                ret = -1;
+            }
+        }
+        free(zeroes);
+        return ret;
+    }
+
     int deinit_ss_zns_device(struct user_zns_device *my_dev) {
         fclose((FILE *)(my_dev->_private));
         free(my_dev);
         return 0;
     }
+
+    int zns_udevice_get_stats(struct user_zns_device *my_dev, struct zns_udevice_stats *stats) {
+        // a plain file has no log and no GC to count
+        memset(stats, 0, sizeof(*stats));
+        return 0;
+    }
+
+    int zns_udevice_get_wear(struct user_zns_device *my_dev, uint32_t *resets, uint32_t n_zones) {
+        // nor zones to wear out
+        return 0;
+    }
 }
 
 #endif 
\ No newline at end of file
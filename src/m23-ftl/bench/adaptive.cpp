@@ -0,0 +1,59 @@
+/*
+ * MIT License
+Copyright (c) 2021 - current
+Authors:  Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#include <cstdio>
+#include <algorithm>
+#include "bench.h"
+
+// writes slower than this (us) waited for GC
+static const uint64_t STALL_US = 1000;
+
+static void print_adaptive(const char *name, struct bench_result *result) {
+    std::sort(result->write_lat.begin(), result->write_lat.end());
+    size_t stalls = result->write_lat.end() - std::upper_bound(result->write_lat.begin(), result->write_lat.end(), STALL_US);
+    printf("[stosys-bench] %-10s write p99 %5lu us p99.9 %6lu us max %7lu us stalls %5zu min-free %2u min-exhaustion %7.1f ms WA %6.2f \n",
+           name, percentile(result->write_lat, 99), percentile(result->write_lat, 99.9), result->write_lat.empty() ? 0 : result->write_lat.back(),
+           stalls, result->min_free_zones, result->min_exhaustion_us == UINT64_MAX ? -1.0 : result->min_exhaustion_us / 1000.0,
+           write_amplification(&result->stats));
+}
+
+// on-demand, background and adaptive background GC under overwrites that come in bursts
+int bench_adaptive(struct bench_options *opts, struct zdev_init_params *params) {
+    const char *names[] = {"on-demand", "background", "adaptive"};
+    struct bench_workload workload = bench_workload_of(opts);
+    struct bench_result results[3];
+    for (int i = 0; i < 3; i++) {
+        params->gc_bw_pct = i == 0 ? 0 : opts->gc_bw_pct;
+        params->gc_adaptive = i == 2;
+        int ret = run_bursty_workload(params, &workload, opts->burst_blocks, opts->pause_us, &results[i]);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    print_rule();
+    for (int i = 0; i < 3; i++) {
+        print_adaptive(names[i], &results[i]);
+    }
+    print_rule();
+    return 0;
+}
@@ -0,0 +1,496 @@
+/*
+ * MIT License
+Copyright (c) 2021 - current
+Authors:  Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <algorithm>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "bench.h"
+#include "../../common/utils.h"
+
+// LBAs per read when the device is read back
+static const uint32_t VERIFY_BLOCKS = 64;
+// shown of a failed read back, the rest is only counted
+static const uint64_t VERIFY_SHOWN = 5;
+
+struct bench_workload bench_workload_of(const struct bench_options *opts) {
+    struct bench_workload workload{};
+    workload.n_writes = opts->n_writes;
+    workload.hot_pct = opts->hot_pct;
+    workload.hot_space_pct = opts->hot_space_pct;
+    workload.read_pct = opts->read_pct;
+    workload.io_blocks = 1;
+    workload.seed = opts->seed;
+    return workload;
+}
+
+void bench_fill_block(char *block, uint32_t lsb, uint64_t lba, uint64_t seq) {
+    // 33 - 126 printable chars, 93
+    for (uint32_t j = 0; j < lsb - 16; j++) {
+        block[j] = (char) (33 + (lba + seq + j) % 93);
+    }
+    memcpy(block + lsb - 16, &lba, 8);
+    memcpy(block + lsb - 8, &seq, 8);
+}
+
+void bench_dup_block(char *block, uint32_t lsb, uint64_t pool_index) {
+    std::mt19937_64 pool(pool_index);
+    for (uint32_t j = 0; j + 8 <= lsb; j += 8) {
+        uint64_t r = pool();
+        memcpy(block + j, &r, 8);
+    }
+}
+
+int bench_write(struct user_zns_device *my_dev, uint64_t address, void *buf, uint32_t size, int hint, uint64_t *max_call_us) {
+    while (true) {
+        uint64_t t0 = microseconds_since_epoch();
+        int ret = zns_udevice_write_hint(my_dev, address, buf, size, hint);
+        if (max_call_us != nullptr) {
+            *max_call_us = std::max(*max_call_us, microseconds_since_epoch() - t0);
+        }
+        if (ret != -EAGAIN) {
+            return ret;
+        }
+        struct zns_udevice_space space{};
+        zns_udevice_get_space(my_dev, &space);
+        usleep(std::max<uint64_t>(1, space.retry_after_us));
+    }
+}
+
+int bench_open(struct zdev_init_params *params, struct user_zns_device **my_dev, std::vector<uint64_t> *expected) {
+    int ret = init_ss_zns_device(params, my_dev);
+    if (ret != 0) {
+        printf("Error: failed to initialize the device, ret %d \n", ret);
+        return ret;
+    }
+    uint32_t lsb = (*my_dev)->lba_size_bytes;
+    uint64_t lbas = (*my_dev)->capacity_bytes / lsb;
+    char *buf = (char *) calloc(1, lsb);
+    for (uint64_t i = 0; i < lbas && ret == 0; i++) {
+        bench_fill_block(buf, lsb, i, 0);
+        ret = bench_write(*my_dev, i * lsb, buf, lsb, ZNS_HINT_NONE, nullptr);
+    }
+    free(buf);
+    if (ret != 0) {
+        printf("Error: filling the device failed, ret %d \n", ret);
+        deinit_ss_zns_device(*my_dev);
+        *my_dev = nullptr;
+        return ret;
+    }
+    expected->assign(lbas, 0);
+    return 0;
+}
+
+// 0 if block is what expected says LBA lba holds
+static int verify_block(const char *block, uint32_t lsb, uint64_t lba, uint64_t expected, uint32_t skip_bytes, char *want) {
+    if (expected == BENCH_ZERO) {
+        memset(want, 0, lsb);
+        return memcmp(block, want, lsb) != 0;
+    }
+    if (expected != BENCH_ANY && (expected & BENCH_DUP) != 0) {
+        bench_dup_block(want, lsb, expected & ~BENCH_DUP);
+        return memcmp(block, want, lsb) != 0;
+    }
+    // the random bytes may have covered what tells the block apart
+    if (skip_bytes > lsb - 16) {
+        return 0;
+    }
+    uint64_t block_lba, block_seq;
+    memcpy(&block_lba, block + lsb - 16, 8);
+    memcpy(&block_seq, block + lsb - 8, 8);
+    if (block_lba != lba || (expected != BENCH_ANY && block_seq != expected)) {
+        return 1;
+    }
+    bench_fill_block(want, lsb, lba, block_seq);
+    return memcmp(block + skip_bytes, want + skip_bytes, lsb - skip_bytes) != 0;
+}
+
+int bench_verify(struct user_zns_device *my_dev, const std::vector<uint64_t> &expected, uint32_t skip_bytes) {
+    uint32_t lsb = my_dev->lba_size_bytes;
+    char *buf = (char *) calloc(VERIFY_BLOCKS, lsb);
+    char *want = (char *) calloc(1, lsb);
+    uint64_t bad = 0;
+    int ret = 0;
+    for (uint64_t lba = 0; lba < expected.size() && ret == 0; lba += VERIFY_BLOCKS) {
+        uint32_t n = std::min<uint64_t>(VERIFY_BLOCKS, expected.size() - lba);
+        ret = zns_udevice_read(my_dev, lba * lsb, buf, n * lsb);
+        if (ret != 0) {
+            printf("Error: reading back LBA %lu failed, ret %d \n", lba, ret);
+            break;
+        }
+        for (uint32_t b = 0; b < n; b++) {
+            if (verify_block(buf + (uint64_t) b * lsb, lsb, lba + b, expected[lba + b], skip_bytes, want) != 0 && bad++ < VERIFY_SHOWN) {
+                printf("Error: LBA %lu does not hold what was written last \n", lba + b);
+            }
+        }
+    }
+    free(buf);
+    free(want);
+    if (ret == 0 && bad != 0) {
+        printf("Error: %lu of %zu LBAs do not hold what was written last \n", bad, expected.size());
+        ret = -EIO;
+    }
+    return ret;
+}
+
+static uint64_t cpu_time_us() {
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000UL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+void bench_stats_since(struct zns_udevice_stats *stats, const struct zns_udevice_stats *fill) {
+    stats->user_write_blocks -= fill->user_write_blocks;
+    stats->log_write_blocks -= fill->log_write_blocks;
+    stats->direct_write_blocks -= fill->direct_write_blocks;
+    stats->gc_read_blocks -= fill->gc_read_blocks;
+    stats->gc_write_blocks -= fill->gc_write_blocks;
+    stats->gc_copy_blocks -= fill->gc_copy_blocks;
+    stats->gc_time_us -= fill->gc_time_us;
+    stats->gc_runs -= fill->gc_runs;
+    stats->gc_zones_reclaimed -= fill->gc_zones_reclaimed;
+    stats->full_merges -= fill->full_merges;
+    stats->partial_merges -= fill->partial_merges;
+    stats->switch_merges -= fill->switch_merges;
+    stats->chunk_merges -= fill->chunk_merges;
+    stats->chunk_relocations -= fill->chunk_relocations;
+    stats->hot_write_blocks -= fill->hot_write_blocks;
+    stats->cold_write_blocks -= fill->cold_write_blocks;
+    stats->gc_victim_blocks -= fill->gc_victim_blocks;
+    stats->wear_migrations -= fill->wear_migrations;
+    stats->gc_relocated_blocks -= fill->gc_relocated_blocks;
+    stats->hint_write_blocks -= fill->hint_write_blocks;
+    stats->zero_write_blocks -= fill->zero_write_blocks;
+    stats->trim_blocks -= fill->trim_blocks;
+    stats->trim_zones_reclaimed -= fill->trim_zones_reclaimed;
+    stats->compress_blocks -= fill->compress_blocks;
+    stats->compress_saved_blocks -= fill->compress_saved_blocks;
+    stats->dedup_write_blocks -= fill->dedup_write_blocks;
+    stats->dedup_collisions -= fill->dedup_collisions;
+    stats->checksum_errors -= fill->checksum_errors;
+    stats->write_backoffs -= fill->write_backoffs;
+}
+
+// the counters of the run and the device read back, then the device is closed
+static int bench_close(struct user_zns_device *my_dev, const std::vector<uint64_t> &expected, uint32_t skip_bytes,
+                       struct bench_result *result, int ret) {
+    if (ret == 0) {
+        zns_udevice_get_stats(my_dev, &result->stats);
+        bench_stats_since(&result->stats, &result->fill);
+        ret = bench_verify(my_dev, expected, skip_bytes);
+    }
+    int dret = deinit_ss_zns_device(my_dev);
+    return ret != 0 ? ret : dret;
+}
+
+int run_skewed_workload(struct zdev_init_params *params, const struct bench_workload *workload, struct bench_result *result) {
+    struct user_zns_device *my_dev = nullptr;
+    std::vector<uint64_t> expected;
+    int ret = bench_open(params, &my_dev, &expected);
+    if (ret != 0) {
+        return ret;
+    }
+    uint32_t lsb = my_dev->lba_size_bytes, io_blocks = workload->io_blocks;
+    uint64_t lbas = expected.size(), seq = 0;
+    uint64_t live_lbas = std::max<uint64_t>(1, lbas - lbas * workload->dead_pct / 100);
+    uint64_t hot_lbas = std::max<uint64_t>(1, live_lbas * workload->hot_space_pct / 100);
+    uint32_t noise_bytes = (uint64_t) lsb * workload->random_pct / 100 / 8 * 8;
+    result->lba_size = lsb;
+    // the reset counters live as long as the device, only what this run adds counts
+    std::vector<uint32_t> wear_start(my_dev->tparams.zns_num_zones);
+    zns_udevice_get_wear(my_dev, wear_start.data(), wear_start.size());
+    char *buf = (char *) calloc(io_blocks, lsb);
+    char *zero_buf = (char *) calloc(io_blocks, lsb);
+
+    {
+        std::mt19937_64 gen(workload->seed + 1);
+        std::uniform_int_distribution<uint64_t> dead(live_lbas, lbas - 1);
+        for (uint64_t i = live_lbas; i < lbas && ret == 0; i++) {
+            uint64_t lba = dead(gen);
+            bench_fill_block(buf, lsb, lba, ++seq);
+            ret = bench_write(my_dev, lba * lsb, buf, lsb, ZNS_HINT_NONE, nullptr);
+            expected[lba] = seq;
+        }
+    }
+    if (ret != 0) {
+        printf("Error: rewriting the dead LBAs failed, ret %d \n", ret);
+        goto done;
+    }
+    // only the overwrites are measured
+    zns_udevice_get_stats(my_dev, &result->fill);
+    if (workload->trim_dead && live_lbas < lbas) {
+        ret = zns_udevice_trim(my_dev, live_lbas * lsb, (lbas - live_lbas) * lsb);
+        if (ret != 0) {
+            printf("Error: trimming the dead LBAs failed, ret %d \n", ret);
+            goto done;
+        }
+        std::fill(expected.begin() + live_lbas, expected.end(), BENCH_ZERO);
+    }
+
+    {
+        std::mt19937_64 gen(workload->seed), noise(workload->seed + 2);
+        std::uniform_int_distribution<int> pct(0, 99);
+        std::uniform_int_distribution<uint64_t> hot(0, hot_lbas - 1), cold(std::min(hot_lbas, live_lbas - 1), live_lbas - 1);
+        uint64_t start = microseconds_since_epoch(), cpu_start = cpu_time_us();
+        for (uint64_t i = 0; i < workload->n_writes; i += io_blocks) {
+            bool is_hot = pct(gen) < workload->hot_pct || hot_lbas == live_lbas;
+            uint64_t lba = is_hot ? hot(gen) : cold(gen);
+            lba = std::min(lba - lba % io_blocks, lbas - io_blocks);
+            bool is_read = pct(gen) < workload->read_pct;
+            uint64_t t0 = microseconds_since_epoch();
+            if (is_read) {
+                ret = zns_udevice_read(my_dev, lba * lsb, buf, io_blocks * lsb);
+                result->read_lat.push_back(microseconds_since_epoch() - t0);
+            } else {
+                char *data = buf;
+                if (pct(gen) < workload->zero_pct) {
+                    data = zero_buf;
+                    std::fill(expected.begin() + lba, expected.begin() + lba + io_blocks, BENCH_ZERO);
+                } else {
+                    for (uint32_t b = 0; b < io_blocks; b++) {
+                        char *block = buf + (uint64_t) b * lsb;
+                        if (workload->dup_pct > 0 && pct(noise) < workload->dup_pct) {
+                            uint64_t pool_index = noise() % DUP_POOL_BLOCKS;
+                            bench_dup_block(block, lsb, pool_index);
+                            expected[lba + b] = BENCH_DUP | pool_index;
+                            continue;
+                        }
+                        bench_fill_block(block, lsb, lba + b, ++seq);
+                        expected[lba + b] = seq;
+                        for (uint32_t j = 0; j < noise_bytes; j += 8) {
+                            uint64_t r = noise();
+                            memcpy(block + j, &r, 8);
+                        }
+                    }
+                }
+                int hint = !workload->hints ? ZNS_HINT_NONE : is_hot ? ZNS_HINT_SHORT : ZNS_HINT_LONG;
+                ret = bench_write(my_dev, lba * lsb, data, io_blocks * lsb, hint, &result->max_call_us);
+                result->write_lat.push_back(microseconds_since_epoch() - t0);
+            }
+            if (ret != 0) {
+                printf("Error: %s %lu at lba %lu failed, ret %d \n", is_read ? "read" : "write", i, lba, ret);
+                goto done;
+            }
+        }
+        result->elapsed_us = microseconds_since_epoch() - start;
+        result->cpu_us = cpu_time_us() - cpu_start;
+    }
+
+    result->wear.resize(wear_start.size());
+    zns_udevice_get_wear(my_dev, result->wear.data(), result->wear.size());
+    for (size_t i = 0; i < wear_start.size(); i++) {
+        result->wear[i] -= wear_start[i];
+    }
+
+    done:
+    free(buf);
+    free(zero_buf);
+    return bench_close(my_dev, expected, noise_bytes, result, ret);
+}
+
+int run_bursty_workload(struct zdev_init_params *params, const struct bench_workload *workload, uint32_t burst_blocks,
+                        uint32_t pause_us, struct bench_result *result) {
+    struct user_zns_device *my_dev = nullptr;
+    std::vector<uint64_t> expected;
+    int ret = bench_open(params, &my_dev, &expected);
+    if (ret != 0) {
+        return ret;
+    }
+    uint32_t lsb = my_dev->lba_size_bytes;
+    uint64_t lbas = expected.size(), seq = 0;
+    uint64_t hot_lbas = std::max<uint64_t>(1, lbas * workload->hot_space_pct / 100);
+    result->lba_size = lsb;
+    result->min_free_zones = UINT32_MAX;
+    result->min_exhaustion_us = UINT64_MAX;
+    zns_udevice_get_stats(my_dev, &result->fill);
+    char *buf = (char *) calloc(1, lsb);
+    std::mt19937_64 gen(workload->seed);
+    std::uniform_int_distribution<int> pct(0, 99);
+    std::uniform_int_distribution<uint64_t> hot(0, hot_lbas - 1), cold(std::min(hot_lbas, lbas - 1), lbas - 1);
+    uint64_t start = microseconds_since_epoch();
+    for (uint64_t i = 0; i < workload->n_writes && ret == 0;) {
+        for (uint32_t b = 0; b < burst_blocks && i < workload->n_writes && ret == 0; b++, i++) {
+            uint64_t lba = pct(gen) < workload->hot_pct ? hot(gen) : cold(gen);
+            bench_fill_block(buf, lsb, lba, ++seq);
+            uint64_t t0 = microseconds_since_epoch();
+            ret = zns_udevice_write(my_dev, lba * lsb, buf, lsb);
+            result->write_lat.push_back(microseconds_since_epoch() - t0);
+            expected[lba] = seq;
+        }
+        struct zns_udevice_space space{};
+        zns_udevice_get_space(my_dev, &space);
+        result->min_free_zones = std::min(result->min_free_zones, space.free_log_zones);
+        result->min_exhaustion_us = std::min(result->min_exhaustion_us, space.exhaustion_us);
+        usleep(pause_us);
+    }
+    result->elapsed_us = microseconds_since_epoch() - start;
+    if (ret != 0) {
+        printf("Error: an overwrite failed, ret %d \n", ret);
+    }
+    free(buf);
+    return bench_close(my_dev, expected, 0, result, ret);
+}
+
+// one writer of run_threaded_workload, it overwrites its share of the LBAs with a generator of its own
+struct writer_args {
+    struct user_zns_device *dev;
+    uint64_t n_writes, lbas, hot_lbas;
+    int hot_pct;
+    unsigned seed;
+    // the seq of the writer's blocks starts here
+    uint64_t seq;
+    std::vector<uint64_t> write_lat;
+    std::vector<uint64_t> written;
+    int ret;
+};
+
+static void *writer_thread(void *args) {
+    struct writer_args *writer = (struct writer_args *) args;
+    uint32_t lsb = writer->dev->lba_size_bytes;
+    char *buf = (char *) calloc(1, lsb);
+    std::mt19937_64 gen(writer->seed);
+    std::uniform_int_distribution<int> pct(0, 99);
+    std::uniform_int_distribution<uint64_t> hot(0, writer->hot_lbas - 1), cold(std::min(writer->hot_lbas, writer->lbas - 1), writer->lbas - 1);
+    for (uint64_t i = 0; i < writer->n_writes && writer->ret == 0; i++) {
+        uint64_t lba = pct(gen) < writer->hot_pct ? hot(gen) : cold(gen);
+        bench_fill_block(buf, lsb, lba, writer->seq + i);
+        uint64_t t0 = microseconds_since_epoch();
+        writer->ret = zns_udevice_write(writer->dev, lba * lsb, buf, lsb);
+        writer->write_lat.push_back(microseconds_since_epoch() - t0);
+        writer->written.push_back(lba);
+    }
+    free(buf);
+    return nullptr;
+}
+
+int run_threaded_workload(struct zdev_init_params *params, const struct bench_workload *workload, struct bench_result *result) {
+    uint32_t n_threads = workload->threads;
+    struct user_zns_device *my_dev = nullptr;
+    std::vector<uint64_t> expected;
+    int ret = bench_open(params, &my_dev, &expected);
+    if (ret != 0) {
+        return ret;
+    }
+    uint64_t lbas = expected.size();
+    result->lba_size = my_dev->lba_size_bytes;
+    zns_udevice_get_stats(my_dev, &result->fill);
+    std::vector<struct writer_args> writers(n_threads);
+    std::vector<pthread_t> threads(n_threads);
+    uint64_t start = microseconds_since_epoch();
+    for (uint32_t t = 0; t < n_threads; t++) {
+        writers[t].dev = my_dev;
+        writers[t].n_writes = workload->n_writes / n_threads;
+        writers[t].lbas = lbas;
+        writers[t].hot_lbas = std::max<uint64_t>(1, lbas * workload->hot_space_pct / 100);
+        writers[t].hot_pct = workload->hot_pct;
+        writers[t].seed = workload->seed + t;
+        writers[t].seq = 1 + (uint64_t) t * writers[t].n_writes;
+        writers[t].ret = 0;
+        if (pthread_create(&threads[t], nullptr, writer_thread, &writers[t]) != 0) {
+            printf("Error: failed to start writer %u \n", t);
+            exit(-1);
+        }
+    }
+    for (uint32_t t = 0; t < n_threads; t++) {
+        pthread_join(threads[t], nullptr);
+        ret = ret != 0 ? ret : writers[t].ret;
+        result->write_lat.insert(result->write_lat.end(), writers[t].write_lat.begin(), writers[t].write_lat.end());
+        // which writer got to an LBA last is up to the FTL
+        for (uint64_t lba : writers[t].written) {
+            expected[lba] = BENCH_ANY;
+        }
+    }
+    result->elapsed_us = microseconds_since_epoch() - start;
+    if (ret != 0) {
+        printf("Error: an overwrite failed, ret %d \n", ret);
+    }
+    return bench_close(my_dev, expected, 0, result, ret);
+}
+
+int bench_compare(struct bench_options *opts, struct zdev_init_params *params, bench_configure_fn configure,
+                  bench_print_fn print, const char *const *names) {
+    struct bench_workload workload = bench_workload_of(opts);
+    struct bench_result results[2]{};
+    for (int run = 0; run < 2; run++) {
+        configure(opts, params, &workload, run);
+        int ret = workload.threads ? run_threaded_workload(params, &workload, &results[run]) :
+                  run_skewed_workload(params, &workload, &results[run]);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    print_rule();
+    print(opts, names, results);
+    print_rule();
+    return 0;
+}
+
+double write_amplification(struct zns_udevice_stats *stats) {
+    if (stats->user_write_blocks == 0) {
+        return 0;
+    }
+    return (double) (stats->log_write_blocks + stats->direct_write_blocks + stats->gc_write_blocks) / stats->user_write_blocks;
+}
+
+double write_mib_per_s(struct bench_result *result) {
+    if (result->elapsed_us == 0) {
+        return 0;
+    }
+    return (double) result->stats.user_write_blocks * result->lba_size / (1024 * 1024) * 1000000 / result->elapsed_us;
+}
+
+uint64_t percentile(std::vector<uint64_t> &lat, double p) {
+    if (lat.empty()) {
+        return 0;
+    }
+    return lat[std::min<size_t>(lat.size() - 1, (size_t)(p / 100.0 * lat.size()))];
+}
+
+void print_stats(const char *name, struct zns_udevice_stats *stats, uint64_t elapsed_us) {
+    printf("[stosys-bench] %-10s user %8lu log %8lu direct %8lu gc-read %9lu gc-write %9lu gc-runs %6lu merges full/partial/switch %lu/%lu/%lu hot %8lu cold %8lu WA %6.2f time %lu ms \n",
+           name, stats->user_write_blocks, stats->log_write_blocks, stats->direct_write_blocks, stats->gc_read_blocks,
+           stats->gc_write_blocks, stats->gc_runs, stats->full_merges, stats->partial_merges, stats->switch_merges, stats->hot_write_blocks,
+           stats->cold_write_blocks, write_amplification(stats), elapsed_us / 1000);
+}
+
+void print_latency(const char *name, const char *op, std::vector<uint64_t> &lat) {
+    std::sort(lat.begin(), lat.end());
+    printf("[stosys-bench] %-10s %-5s n %8zu p50 %6lu us p99 %6lu us p99.9 %7lu us max %8lu us \n", name, op, lat.size(),
+           percentile(lat, 50), percentile(lat, 99), percentile(lat, 99.9), lat.empty() ? 0 : lat.back());
+}
+
+void print_throughput(const char *name, struct bench_result *result) {
+    std::sort(result->write_lat.begin(), result->write_lat.end());
+    printf("[stosys-bench] %-14s user %8lu WA %6.2f write p50 %5lu us p99 %6lu us %8.1f MiB/s time %lu ms \n",
+           name, result->stats.user_write_blocks, write_amplification(&result->stats), percentile(result->write_lat, 50),
+           percentile(result->write_lat, 99), write_mib_per_s(result), result->elapsed_us / 1000);
+}
+
+void print_rule() {
+    printf("====================================================================\n");
+}
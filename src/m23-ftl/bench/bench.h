@@ -0,0 +1,181 @@
+/*
+ * MIT License
+Copyright (c) 2021 - current
+Authors:  Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#ifndef STOSYS_PROJECT_BENCH_H
+#define STOSYS_PROJECT_BENCH_H
+
+#include <cstdint>
+#include <vector>
+#include "../zns_device.h"
+
+/*
+ * Shared part of ftl_bench. A run opens the device and fills it (bench_open), runs its workload, takes the
+ * counters, reads the whole device back against what it wrote (bench_verify) and closes it. Most -m modes
+ * compare a base run against a changed one (bench_compare), they only set the two runs up and print them, in
+ * compare.cpp. Modes that run differently live in a file of their own.
+ */
+
+// the options of the command line, the modes take what they need
+struct bench_options {
+    std::vector<char *> device_names;
+    uint64_t n_writes;
+    int hot_pct, hot_space_pct, read_pct;
+    unsigned seed;
+    uint32_t age_buckets;
+    int dead_pct, zero_pct, random_pct, dup_pct;
+    uint32_t io_blocks;
+    uint32_t stripe_blocks;
+    uint32_t shards;
+    uint32_t burst_blocks, pause_us;
+    uint32_t chunk_blocks;
+    uint32_t wear_gap;
+    uint32_t gc_bw_pct;
+    int io_sched;
+};
+
+struct bench_result {
+    // counters of the sequential fill, and of the skewed overwrites alone
+    struct zns_udevice_stats fill;
+    struct zns_udevice_stats stats;
+    uint64_t elapsed_us;
+    // user + system CPU time of the overwrite phase
+    uint64_t cpu_us;
+    uint32_t lba_size;
+    // per command latency (us) of the overwrite phase
+    std::vector<uint64_t> read_lat, write_lat;
+    // resets per zone during the run
+    std::vector<uint32_t> wear;
+    // the longest a single write call of the overwrite phase took (us)
+    uint64_t max_call_us;
+    // after the bursts of run_bursty_workload: the fewest free log zones seen, and the shortest predicted time
+    // until the log is down to the watermark (us)
+    uint32_t min_free_zones;
+    uint64_t min_exhaustion_us;
+};
+
+// the skewed overwrites, hot_pct of them to the hot_space_pct of the LBAs at the start. dead_pct of the LBAs,
+// the top of the space, are written once more in random order after the fill and not touched again, trim_dead
+// trims them before the overwrites. With hints the overwrites carry lifetime hints, zero_pct of them are
+// all-zero blocks. The overwrites go io_blocks LBAs at a time (n_writes counts LBAs), and random_pct of every
+// block written is random bytes. dup_pct of the blocks are one of DUP_POOL_BLOCKS blocks instead, the same
+// content over and over. With threads, that many writers overwrite at once (run_threaded_workload)
+struct bench_workload {
+    uint64_t n_writes;
+    int hot_pct, hot_space_pct, read_pct;
+    int dead_pct;
+    bool trim_dead;
+    bool hints;
+    int zero_pct;
+    uint32_t io_blocks;
+    int random_pct, dup_pct;
+    uint32_t threads;
+    unsigned seed;
+};
+
+static const uint64_t DUP_POOL_BLOCKS = 1024;
+
+// what verify expects of an LBA besides a written block: zeroes, or one of the repeated blocks
+static const uint64_t BENCH_ZERO = UINT64_MAX;
+static const uint64_t BENCH_DUP = 1ULL << 63;
+// the threaded writers race on LBAs, any block written to the LBA will do
+static const uint64_t BENCH_ANY = UINT64_MAX - 1;
+
+// single LBA overwrites of the options, no dead space, zeroes, random bytes or repeats
+struct bench_workload bench_workload_of(const struct bench_options *opts);
+
+// a block of pattern that carries the LBA and write it was written with in its last 16 bytes, and one of the
+// repeated blocks
+void bench_fill_block(char *block, uint32_t lsb, uint64_t lba, uint64_t seq);
+void bench_dup_block(char *block, uint32_t lsb, uint64_t pool_index);
+
+// opens the device and writes every LBA once (seq 0), expected gets an entry per LBA
+int bench_open(struct zdev_init_params *params, struct user_zns_device **my_dev, std::vector<uint64_t> *expected);
+// reads the device back: every LBA holds the block of its expected seq, zeroes or the repeated block. The
+// first skip_bytes of written blocks are random and not checked
+int bench_verify(struct user_zns_device *my_dev, const std::vector<uint64_t> &expected, uint32_t skip_bytes);
+// a write that backs off while the FTL turns it away (write_nonblock): it sleeps as long as the FTL
+// expects GC to take and tries again. max_call_us, if given, keeps the longest call
+int bench_write(struct user_zns_device *my_dev, uint64_t address, void *buf, uint32_t size, int hint, uint64_t *max_call_us);
+// what a run added to the counters since fill was taken
+void bench_stats_since(struct zns_udevice_stats *stats, const struct zns_udevice_stats *fill);
+
+int run_skewed_workload(struct zdev_init_params *params, const struct bench_workload *workload, struct bench_result *result);
+// n_writes single LBA overwrites in bursts of burst_blocks with pause_us of quiet after each. The log is
+// looked at after every burst
+int run_bursty_workload(struct zdev_init_params *params, const struct bench_workload *workload, uint32_t burst_blocks,
+                        uint32_t pause_us, struct bench_result *result);
+// n_writes single LBA overwrites from threads writers at once
+int run_threaded_workload(struct zdev_init_params *params, const struct bench_workload *workload, struct bench_result *result);
+
+// a mode that compares two runs of the workload. configure sets params and the workload up for run 0, the base,
+// and then for run 1, the changed one, what it sets stays for the next run. print shows both results, names has
+// the name of each run
+typedef void (*bench_configure_fn)(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+typedef void (*bench_print_fn)(struct bench_options *opts, const char *const *names, struct bench_result *results);
+int bench_compare(struct bench_options *opts, struct zdev_init_params *params, bench_configure_fn configure,
+                  bench_print_fn print, const char *const *names);
+
+double write_amplification(struct zns_udevice_stats *stats);
+double write_mib_per_s(struct bench_result *result);
+// lat has to be sorted
+uint64_t percentile(std::vector<uint64_t> &lat, double p);
+void print_stats(const char *name, struct zns_udevice_stats *stats, uint64_t elapsed_us);
+void print_latency(const char *name, const char *op, std::vector<uint64_t> &lat);
+void print_throughput(const char *name, struct bench_result *result);
+void print_rule();
+
+// the modes that run on their own, each returns 0 or the error of the run that failed
+int bench_gc(struct bench_options *opts, struct zdev_init_params *params);
+int bench_checksum(struct bench_options *opts, struct zdev_init_params *params);
+int bench_adaptive(struct bench_options *opts, struct zdev_init_params *params);
+int bench_chunk(struct bench_options *opts, struct zdev_init_params *params);
+int bench_multi(struct bench_options *opts, struct zdev_init_params *params);
+
+// the modes bench_compare runs
+void bench_hotcold_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_hotcold_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_copy_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_copy_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_qos_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_qos_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_wear_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_wear_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_age_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_age_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_trim_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_trim_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_hint_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_hint_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_zero_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_zero_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_compress_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_compress_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_dedup_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_dedup_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_backpressure_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_backpressure_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_stripe_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_stripe_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+void bench_shard_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run);
+void bench_shard_print(struct bench_options *opts, const char *const *names, struct bench_result *results);
+
+#endif //STOSYS_PROJECT_BENCH_H
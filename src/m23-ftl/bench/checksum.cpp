@@ -0,0 +1,57 @@
+/*
+ * MIT License
+Copyright (c) 2021 - current
+Authors:  Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#include <cstdio>
+#include <algorithm>
+#include "bench.h"
+
+static void print_checksum(const char *name, struct bench_result *result) {
+    std::sort(result->read_lat.begin(), result->read_lat.end());
+    std::sort(result->write_lat.begin(), result->write_lat.end());
+    printf("[stosys-bench] %-10s errors %4lu read p50 %6lu us write p50 %6lu us host cpu %lu ms time %lu ms \n",
+           name, result->stats.checksum_errors, percentile(result->read_lat, 50), percentile(result->write_lat, 50),
+           result->cpu_us / 1000, result->elapsed_us / 1000);
+}
+
+// the host cost of multi-block reads and overwrites without checksums, with checksums kept and with them verified
+int bench_checksum(struct bench_options *opts, struct zdev_init_params *params) {
+    const int modes[] = {ZNS_CHECKSUM_OFF, ZNS_CHECKSUM_STORE, ZNS_CHECKSUM_VERIFY};
+    const char *names[] = {"off", "store", "verify"};
+    struct bench_workload workload = bench_workload_of(opts);
+    struct bench_result results[3];
+    workload.io_blocks = opts->io_blocks;
+    workload.random_pct = opts->random_pct;
+    for (int i = 0; i < 3; i++) {
+        params->checksum = modes[i];
+        int ret = run_skewed_workload(params, &workload, &results[i]);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    print_rule();
+    for (int i = 0; i < 3; i++) {
+        print_checksum(names[i], &results[i]);
+    }
+    print_rule();
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * MIT License
+Copyright (c) 2021 - current
+Authors:  Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#include <cstdio>
+#include "bench.h"
+
+static void print_chunk(const char *name, struct bench_result *result) {
+    struct zns_udevice_stats *stats = &result->stats;
+    printf("[stosys-bench] %-10s gc-read %9lu gc-write %9lu full-merges %6lu chunk-merges %6lu chunks-moved %6lu gc-time %7.1f ms WA %6.2f \n",
+           name, stats->gc_read_blocks, stats->gc_write_blocks, stats->full_merges, stats->chunk_merges, stats->chunk_relocations,
+           stats->gc_time_us / 1000.0, write_amplification(stats));
+}
+
+// merges of whole data zones, also with the zones of the chunk area added to the log, against merges of the
+// chunks that changed. Single LBA overwrites, so a log zone holds a few blocks of many logical zones
+int bench_chunk(struct bench_options *opts, struct zdev_init_params *params) {
+    struct bench_workload workload = bench_workload_of(opts);
+    struct bench_result base{}, wide{}, changed{};
+    int log_zones = params->log_zones;
+    int ret = run_skewed_workload(params, &workload, &base);
+    if (ret != 0) {
+        return ret;
+    }
+    params->log_zones = 2 * log_zones;
+    ret = run_skewed_workload(params, &workload, &wide);
+    if (ret != 0) {
+        return ret;
+    }
+    params->log_zones = log_zones;
+    params->chunk_blocks = opts->chunk_blocks;
+    ret = run_skewed_workload(params, &workload, &changed);
+    if (ret != 0) {
+        return ret;
+    }
+
+    print_rule();
+    print_chunk("zone", &base);
+    print_chunk("zone-2xlog", &wide);
+    print_chunk("chunk", &changed);
+    print_rule();
+    return 0;
+}
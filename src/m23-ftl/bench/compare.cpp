@@ -0,0 +1,290 @@
+/*
+ * MIT License
+Copyright (c) 2021 - current
+Authors:  Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include "bench.h"
+#include "../../common/unused.h"
+
+// The modes that compare a base run against a changed one, bench_compare runs them. Each sets the two runs
+// up and prints them, the rows of the mode table in ftl_bench.cpp name the runs.
+
+// write amplification without and with hot/cold separation
+void bench_hotcold_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    UNUSED(opts);
+    UNUSED(workload);
+    params->hot_cold = run == 1;
+}
+
+void bench_hotcold_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    UNUSED(opts);
+    print_stats("fill", &results[0].fill, 0);
+    for (int i = 0; i < 2; i++) {
+        print_stats(names[i], &results[i].stats, results[i].elapsed_us);
+    }
+    double wa_mixed = write_amplification(&results[0].stats), wa_separated = write_amplification(&results[1].stats);
+    printf("[stosys-bench] hot/cold separation changes write amplification by %+.2f (%+.1f%%) \n",
+           wa_separated - wa_mixed, wa_mixed > 0 ? 100.0 * (wa_separated - wa_mixed) / wa_mixed : 0.0);
+}
+
+// GC throughput and host CPU time of host copies and NVMe Copy offload
+void bench_copy_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    UNUSED(opts);
+    UNUSED(workload);
+    params->copy_offload = run == 1;
+}
+
+void bench_copy_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    UNUSED(opts);
+    for (int i = 0; i < 2; i++) {
+        print_stats(names[i], &results[i].stats, results[i].elapsed_us);
+    }
+    for (int i = 0; i < 2; i++) {
+        struct zns_udevice_stats *stats = &results[i].stats;
+        double gc_mib = (double) stats->gc_write_blocks * results[i].lba_size / (1024 * 1024);
+        double gc_s = stats->gc_time_us / 1000000.0;
+        printf("[stosys-bench] %-10s gc-write %8.1f MiB (copied on device %5.1f%%) in %8.1f ms, %8.1f MiB/s, host cpu %lu ms \n",
+               names[i], gc_mib, stats->gc_write_blocks ? 100.0 * stats->gc_copy_blocks / stats->gc_write_blocks : 0.0,
+               gc_s * 1000, gc_s > 0 ? gc_mib / gc_s : 0.0, results[i].cpu_us / 1000);
+    }
+    if (results[1].stats.gc_copy_blocks == 0) {
+        printf("[stosys-bench] the device does not support NVMe Copy, both runs used the host copy \n");
+    }
+}
+
+// foreground latency with GC only on demand and with rate-limited background GC, or of background GC without
+// and with the I/O scheduler
+void bench_qos_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    UNUSED(workload);
+    params->gc_bw_pct = run == 1 || opts->io_sched ? opts->gc_bw_pct : 0;
+    params->io_sched = run == 1 ? opts->io_sched : 0;
+}
+
+void bench_qos_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    static const char *const sched_names[] = {"no-sched", "sched"};
+    if (opts->io_sched) {
+        names = sched_names;
+    }
+    for (int i = 0; i < 2; i++) {
+        print_stats(names[i], &results[i].stats, results[i].elapsed_us);
+    }
+    for (int i = 0; i < 2; i++) {
+        print_latency(names[i], "read", results[i].read_lat);
+        print_latency(names[i], "write", results[i].write_lat);
+    }
+}
+
+// how evenly zones wear out without and with static wear leveling
+void bench_wear_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    UNUSED(workload);
+    params->wear_gap = run == 1 ? opts->wear_gap : 0;
+}
+
+void bench_wear_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    UNUSED(opts);
+    for (int i = 0; i < 2; i++) {
+        std::vector<uint32_t> &wear = results[i].wear;
+        if (wear.empty()) {
+            continue;
+        }
+        double mean = 0, var = 0;
+        for (uint32_t resets : wear) {
+            mean += resets;
+        }
+        mean /= wear.size();
+        for (uint32_t resets : wear) {
+            var += (resets - mean) * (resets - mean);
+        }
+        printf("[stosys-bench] %-10s resets per zone min %6u max %6u mean %8.1f stddev %8.1f migrations %6lu WA %6.2f \n",
+               names[i], *std::min_element(wear.begin(), wear.end()), *std::max_element(wear.begin(), wear.end()), mean,
+               sqrt(var / wear.size()), results[i].stats.wear_migrations, write_amplification(&results[i].stats));
+    }
+}
+
+// GC that always merges against GC that sorts the blocks it moves by age
+void bench_age_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    UNUSED(workload);
+    params->gc_age_buckets = run == 1 ? opts->age_buckets : 0;
+}
+
+void bench_age_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    UNUSED(opts);
+    for (int i = 0; i < 2; i++) {
+        struct zns_udevice_stats *stats = &results[i].stats;
+        printf("[stosys-bench] %-10s gc-read %9lu gc-write %9lu relocated %8lu full-merges %6lu gc-runs %6lu WA %6.2f \n",
+               names[i], stats->gc_read_blocks, stats->gc_write_blocks, stats->gc_relocated_blocks, stats->full_merges,
+               stats->gc_runs, write_amplification(stats));
+    }
+}
+
+// the top of the LBA space is rewritten after the fill and then left dead (deleted files), untouched or trimmed
+void bench_trim_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    UNUSED(params);
+    workload->dead_pct = opts->dead_pct;
+    workload->trim_dead = run == 1;
+}
+
+void bench_trim_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    UNUSED(opts);
+    for (int i = 0; i < 2; i++) {
+        struct zns_udevice_stats *stats = &results[i].stats;
+        printf("[stosys-bench] %-10s trimmed %9lu data-zones-freed %6lu gc-read %9lu gc-write %9lu full-merges %6lu WA %6.2f \n",
+               names[i], stats->trim_blocks, stats->trim_zones_reclaimed, stats->gc_read_blocks, stats->gc_write_blocks,
+               stats->full_merges, write_amplification(stats));
+    }
+}
+
+// writes without and with lifetime hints, the hot set short lived and the rest long lived
+void bench_hint_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    UNUSED(opts);
+    UNUSED(params);
+    workload->hints = run == 1;
+}
+
+void bench_hint_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    UNUSED(opts);
+    for (int i = 0; i < 2; i++) {
+        struct zns_udevice_stats *stats = &results[i].stats;
+        printf("[stosys-bench] %-10s hinted %9lu victims-live %8lu gc-write %9lu full-merges %6lu gc-runs %6lu WA %6.2f \n",
+               names[i], stats->hint_write_blocks, stats->gc_victim_blocks, stats->gc_write_blocks, stats->full_merges,
+               stats->gc_runs, write_amplification(stats));
+    }
+}
+
+// overwrites with data only and with a share of all-zero blocks, which only go to the map
+void bench_zero_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    params->zero_detect = true;
+    workload->zero_pct = run == 1 ? opts->zero_pct : 0;
+}
+
+void bench_zero_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    UNUSED(opts);
+    for (int i = 0; i < 2; i++) {
+        struct zns_udevice_stats *stats = &results[i].stats;
+        printf("[stosys-bench] %-10s zero-blocks %9lu saved %8.1f MiB log %9lu gc-write %9lu WA %6.2f \n",
+               names[i], stats->zero_write_blocks, (double) stats->zero_write_blocks * results[i].lba_size / (1024 * 1024),
+               stats->log_write_blocks, stats->gc_write_blocks, write_amplification(stats));
+    }
+}
+
+// multi-block overwrites of partly random data without and with log compression
+void bench_compress_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    workload->io_blocks = opts->io_blocks;
+    workload->random_pct = opts->random_pct;
+    params->compress = run == 1;
+}
+
+void bench_compress_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    UNUSED(opts);
+    for (int i = 0; i < 2; i++) {
+        struct zns_udevice_stats *stats = &results[i].stats;
+        printf("[stosys-bench] %-10s packed %9lu saved %8.1f MiB log %9lu gc-write %9lu WA %6.2f host cpu %lu ms time %lu ms \n",
+               names[i], stats->compress_blocks, (double) stats->compress_saved_blocks * results[i].lba_size / (1024 * 1024),
+               stats->log_write_blocks, stats->gc_write_blocks, write_amplification(stats), results[i].cpu_us / 1000,
+               results[i].elapsed_us / 1000);
+    }
+}
+
+// overwrites where a share of the blocks repeat content written before, without and with dedup
+void bench_dedup_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    workload->io_blocks = opts->io_blocks;
+    workload->random_pct = opts->random_pct;
+    workload->dup_pct = opts->dup_pct;
+    params->dedup = run == 1;
+}
+
+void bench_dedup_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    UNUSED(opts);
+    for (int i = 0; i < 2; i++) {
+        struct zns_udevice_stats *stats = &results[i].stats;
+        double gib = (double) stats->user_write_blocks * results[i].lba_size / (1024 * 1024 * 1024);
+        uint64_t stored = stats->user_write_blocks - stats->dedup_write_blocks;
+        printf("[stosys-bench] %-10s deduped %9lu ratio %5.2f collisions %4lu log %9lu gc-write %9lu WA %6.2f host cpu %lu ms (%6.0f ms/GiB) \n",
+               names[i], stats->dedup_write_blocks, stored ? (double) stats->user_write_blocks / stored : 0.0, stats->dedup_collisions,
+               stats->log_write_blocks, stats->gc_write_blocks, write_amplification(stats), results[i].cpu_us / 1000,
+               gib > 0 ? results[i].cpu_us / 1000 / gib : 0.0);
+    }
+}
+
+// writes that wait for GC against writes that are turned away with -EAGAIN and back off
+void bench_backpressure_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    UNUSED(opts);
+    UNUSED(workload);
+    params->write_nonblock = run == 1;
+}
+
+void bench_backpressure_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    UNUSED(opts);
+    for (int i = 0; i < 2; i++) {
+        std::vector<uint64_t> &lat = results[i].write_lat;
+        std::sort(lat.begin(), lat.end());
+        printf("[stosys-bench] %-10s write p50 %5lu us p99 %6lu us max %8lu us longest-call %8lu us backoffs %7lu WA %6.2f %8.1f MiB/s \n",
+               names[i], percentile(lat, 50), percentile(lat, 99), lat.empty() ? 0 : lat.back(), results[i].max_call_us,
+               results[i].stats.write_backoffs, write_amplification(&results[i].stats), write_mib_per_s(&results[i]));
+    }
+}
+
+// the same writes, each a stripe on every member, on the first device and on a volume striped over all of them
+void bench_stripe_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    workload->io_blocks = opts->io_blocks;
+    if (run == 1) {
+        std::string volume_name = opts->device_names[0];
+        for (size_t i = 1; i < opts->device_names.size(); i++) {
+            volume_name += std::string(",") + opts->device_names[i];
+        }
+        params->name = strdup(volume_name.c_str());
+        params->stripe_blocks = opts->stripe_blocks;
+    }
+}
+
+void bench_stripe_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    for (int i = 0; i < 2; i++) {
+        print_throughput(names[i], &results[i]);
+    }
+    printf("[stosys-bench] %zu devices, stripe %u LBAs, %u LBAs per write, volume throughput %.2fx \n", opts->device_names.size(),
+           opts->stripe_blocks, opts->io_blocks, write_mib_per_s(&results[0]) > 0 ? write_mib_per_s(&results[1]) / write_mib_per_s(&results[0]) : 0);
+}
+
+// as many writers as shards, on one FTL and then on the shards. Every shard has a log of its own, the one FTL
+// gets as many log zones as all of them together
+void bench_shard_configure(struct bench_options *opts, struct zdev_init_params *params, struct bench_workload *workload, int run) {
+    workload->threads = opts->shards;
+    if (run == 0) {
+        params->log_zones *= opts->shards;
+    } else {
+        params->log_zones /= opts->shards;
+        params->shards = opts->shards;
+    }
+}
+
+void bench_shard_print(struct bench_options *opts, const char *const *names, struct bench_result *results) {
+    for (int i = 0; i < 2; i++) {
+        print_throughput(names[i], &results[i]);
+    }
+    printf("[stosys-bench] %u shards and writers, sharded throughput %.2fx \n", opts->shards,
+           write_mib_per_s(&results[0]) > 0 ? write_mib_per_s(&results[1]) / write_mib_per_s(&results[0]) : 0);
+}
+
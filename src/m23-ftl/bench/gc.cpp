@@ -0,0 +1,52 @@
+/*
+ * MIT License
+Copyright (c) 2021 - current
+Authors:  Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#include <cstdio>
+#include "bench.h"
+
+static void print_policy(const char *name, struct bench_result *result) {
+    struct zns_udevice_stats *stats = &result->stats;
+    printf("[stosys-bench] %-14s gc-copied %8.1f MiB victims-live %8lu zones-reclaimed %6lu gc-time %8.1f ms WA %6.2f \n",
+           name, (double) stats->gc_write_blocks * result->lba_size / (1024 * 1024), stats->gc_victim_blocks,
+           stats->gc_zones_reclaimed, stats->gc_time_us / 1000.0, write_amplification(stats));
+}
+
+// the GC victim policies
+int bench_gc(struct bench_options *opts, struct zdev_init_params *params) {
+    static const char *names[ZNS_GC_N_POLICIES] = {"greedy", "cost-benefit", "age-threshold", "fifo"};
+    struct bench_workload workload = bench_workload_of(opts);
+    std::vector<struct bench_result> results(ZNS_GC_N_POLICIES);
+    for (int p = 0; p < ZNS_GC_N_POLICIES; p++) {
+        params->gc_policy = p;
+        int ret = run_skewed_workload(params, &workload, &results[p]);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    print_rule();
+    for (int p = 0; p < ZNS_GC_N_POLICIES; p++) {
+        print_policy(names[p], &results[p]);
+    }
+    print_rule();
+    return 0;
+}
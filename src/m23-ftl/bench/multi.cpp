@@ -0,0 +1,104 @@
+/*
+ * MIT License
+Copyright (c) 2021 - current
+Authors:  Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <pthread.h>
+#include "../../common/utils.h"
+#include "bench.h"
+
+// one device of -m multi, every device runs the same workload in its own thread
+struct multi_run {
+    struct zdev_init_params params{};
+    struct bench_workload workload;
+    struct bench_result result;
+    int ret;
+};
+
+static void *multi_run_thread(void *args) {
+    struct multi_run *run = (struct multi_run *) args;
+    run->ret = run_skewed_workload(&run->params, &run->workload, &run->result);
+    return nullptr;
+}
+
+// runs all devices at once, elapsed_us is the wall time of the slowest one
+static int run_multi(std::vector<struct multi_run> &runs, uint64_t *elapsed_us) {
+    std::vector<pthread_t> threads(runs.size());
+    uint64_t start = microseconds_since_epoch();
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (pthread_create(&threads[i], nullptr, multi_run_thread, &runs[i]) != 0) {
+            printf("Error: failed to start the thread for %s \n", runs[i].params.name);
+            exit(-1);
+        }
+    }
+    int ret = 0;
+    for (size_t i = 0; i < runs.size(); i++) {
+        pthread_join(threads[i], nullptr);
+        ret = ret != 0 ? ret : runs[i].ret;
+    }
+    *elapsed_us = microseconds_since_epoch() - start;
+    return ret;
+}
+
+// every device alone first, then all of them at once, the FTL instances share nothing
+int bench_multi(struct bench_options *opts, struct zdev_init_params *params) {
+    std::vector<char *> &device_names = opts->device_names;
+    std::vector<struct multi_run> alone(device_names.size()), together(device_names.size());
+    for (size_t i = 0; i < device_names.size(); i++) {
+        alone[i].params = *params;
+        alone[i].params.name = device_names[i];
+        alone[i].workload = bench_workload_of(opts);
+        alone[i].workload.seed = opts->seed + i;
+        together[i] = alone[i];
+    }
+    uint64_t alone_us = 0, together_us = 0;
+    double alone_mib = 0, together_mib = 0;
+    for (size_t i = 0; i < alone.size(); i++) {
+        uint64_t elapsed_us = 0;
+        std::vector<struct multi_run> one(1, alone[i]);
+        int ret = run_multi(one, &elapsed_us);
+        if (ret != 0) {
+            return ret;
+        }
+        alone[i] = one[0];
+        alone_us += elapsed_us;
+    }
+    int ret = run_multi(together, &together_us);
+    if (ret != 0) {
+        return ret;
+    }
+
+    print_rule();
+    for (size_t i = 0; i < alone.size(); i++) {
+        std::string alone_name = std::string(device_names[i]) + "-alone", together_name = std::string(device_names[i]) + "-at-once";
+        print_throughput(alone_name.c_str(), &alone[i].result);
+        print_throughput(together_name.c_str(), &together[i].result);
+        alone_mib += write_mib_per_s(&alone[i].result);
+        together_mib += write_mib_per_s(&together[i].result);
+    }
+    printf("[stosys-bench] %zu devices one after another %lu ms at %.1f MiB/s, at once %lu ms at %.1f MiB/s, speedup %.2fx \n",
+           device_names.size(), alone_us / 1000, alone_mib / device_names.size(), together_us / 1000, together_mib,
+           together_us ? (double) alone_us / together_us : 0);
+    print_rule();
+    return 0;
+}
@@ -0,0 +1,337 @@
+/*
+* MIT License
+Copyright (c) 2021 - current
+Authors: Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+
+#include "executor.h"
+#include "../common/utils.h"
+
+extern "C" {
+
+    // the worker the calling thread is, if it is one
+    static thread_local struct ss_executor_worker *current_worker = nullptr;
+
+    static bool due_later(const struct ss_task &a, const struct ss_task &b) {
+        return a.due_us > b.due_us;
+    }
+
+    // the oldest urgent task, false if there is none
+    static bool take_urgent(struct ss_executor_worker *worker, struct ss_task *task) {
+        struct ss_executor *executor = worker->executor;
+        if (__atomic_load_n(&executor->pending_urgent, __ATOMIC_SEQ_CST) == 0) {
+            return false;
+        }
+        pthread_mutex_lock(&executor->urgent.lock);
+        if (executor->urgent.deque.empty()) {
+            pthread_mutex_unlock(&executor->urgent.lock);
+            return false;
+        }
+        *task = executor->urgent.deque.front();
+        executor->urgent.deque.pop_front();
+        __atomic_store_n(&worker->running, task->arg, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&executor->urgent.lock);
+        __atomic_sub_fetch(&executor->pending_urgent, 1, __ATOMIC_SEQ_CST);
+        return true;
+    }
+
+    // the next task for a worker: an urgent one, its own newest, else the oldest of another worker. Takes
+    // only the locks of the deques, false if every deque is empty
+    static bool take_task(struct ss_executor_worker *worker, struct ss_task *task) {
+        struct ss_executor *executor = worker->executor;
+        if (take_urgent(worker, task)) {
+            return true;
+        }
+        for (uint32_t i = 0; i < executor->n_workers; i++) {
+            struct ss_executor_worker *victim = &executor->workers[(worker->id + i) % executor->n_workers];
+            pthread_mutex_lock(&victim->lock);
+            if (victim->deque.empty()) {
+                pthread_mutex_unlock(&victim->lock);
+                continue;
+            }
+            if (victim == worker) {
+                *task = victim->deque.back();
+                victim->deque.pop_back();
+            } else {
+                *task = victim->deque.front();
+                victim->deque.pop_front();
+                __atomic_add_fetch(&executor->stolen, 1, __ATOMIC_RELAXED);
+            }
+            __atomic_store_n(&worker->running, task->arg, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&victim->lock);
+            __atomic_sub_fetch(&executor->pending, 1, __ATOMIC_SEQ_CST);
+            return true;
+        }
+        return false;
+    }
+
+    // move the delayed tasks that are due to the deque of the worker, called with the executor lock held
+    static void release_delayed(struct ss_executor_worker *worker) {
+        struct ss_executor *executor = worker->executor;
+        uint64_t now = microseconds_since_epoch();
+        while (!executor->delayed.empty() && executor->delayed.front().due_us <= now) {
+            std::pop_heap(executor->delayed.begin(), executor->delayed.end(), due_later);
+            __atomic_add_fetch(&executor->pending, 1, __ATOMIC_SEQ_CST);
+            pthread_mutex_lock(&worker->lock);
+            worker->deque.push_back(executor->delayed.back());
+            pthread_mutex_unlock(&worker->lock);
+            executor->delayed.pop_back();
+        }
+        __atomic_store_n(&executor->next_due, executor->delayed.empty() ? 0 : executor->delayed.front().due_us, __ATOMIC_RELAXED);
+    }
+
+    static void task_done(struct ss_executor_worker *worker) {
+        struct ss_executor *executor = worker->executor;
+        __atomic_store_n(&worker->running, (void *)nullptr, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&executor->executed, 1, __ATOMIC_RELAXED);
+        // only a cancel waits for a task to finish
+        if (__atomic_load_n(&executor->cancelling, __ATOMIC_SEQ_CST) > 0) {
+            pthread_mutex_lock(&executor->lock);
+            pthread_cond_broadcast(&executor->done);
+            pthread_mutex_unlock(&executor->lock);
+        }
+    }
+
+    static void *urgent_worker(void *args) {
+        struct ss_executor_worker *worker = (struct ss_executor_worker *)args;
+        struct ss_executor *executor = worker->executor;
+        while (true) {
+            struct ss_task task{};
+            if (take_urgent(worker, &task)) {
+                task.fn(task.arg);
+                task_done(worker);
+                continue;
+            }
+            pthread_mutex_lock(&executor->lock);
+            if (__atomic_load_n(&executor->pending_urgent, __ATOMIC_SEQ_CST) == 0) {
+                if (executor->stop) {
+                    pthread_mutex_unlock(&executor->lock);
+                    break;
+                }
+                pthread_cond_wait(&executor->urgent_work, &executor->lock);
+            }
+            pthread_mutex_unlock(&executor->lock);
+        }
+        return (void *)0;
+    }
+
+    static void *executor_worker(void *args) {
+        struct ss_executor_worker *worker = (struct ss_executor_worker *)args;
+        struct ss_executor *executor = worker->executor;
+        current_worker = worker;
+        while (true) {
+            uint64_t next_due = __atomic_load_n(&executor->next_due, __ATOMIC_RELAXED);
+            if (next_due != 0 && next_due <= microseconds_since_epoch()) {
+                pthread_mutex_lock(&executor->lock);
+                release_delayed(worker);
+                pthread_mutex_unlock(&executor->lock);
+            }
+            struct ss_task task{};
+            if (take_task(worker, &task)) {
+                task.fn(task.arg);
+                task_done(worker);
+                continue;
+            }
+
+            // nothing to take, sleep unless a task came in since. A submit that sees no sleeper does not
+            // signal, so sleeping is counted before pending is looked at
+            pthread_mutex_lock(&executor->lock);
+            release_delayed(worker);
+            __atomic_add_fetch(&executor->sleeping, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&executor->pending, __ATOMIC_SEQ_CST) == 0) {
+                if (executor->stop) {
+                    __atomic_sub_fetch(&executor->sleeping, 1, __ATOMIC_SEQ_CST);
+                    pthread_mutex_unlock(&executor->lock);
+                    break;
+                }
+                next_due = executor->next_due;
+                if (next_due == 0) {
+                    pthread_cond_wait(&executor->work, &executor->lock);
+                } else {
+                    struct timespec until{};
+                    until.tv_sec = next_due / 1000000;
+                    until.tv_nsec = (next_due % 1000000) * 1000;
+                    pthread_cond_timedwait(&executor->work, &executor->lock, &until);
+                }
+            }
+            __atomic_sub_fetch(&executor->sleeping, 1, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&executor->lock);
+        }
+        return (void *)0;
+    }
+
+    int ss_executor_init(struct ss_executor *executor, uint32_t n_workers) {
+        executor->n_workers = 0;
+        executor->pending = 0;
+        executor->sleeping = 0;
+        executor->cancelling = 0;
+        executor->next_due = 0;
+        executor->next_worker = 0;
+        executor->stop = false;
+        executor->executed = executor->stolen = 0;
+        pthread_mutex_init(&executor->lock, NULL);
+        pthread_cond_init(&executor->work, NULL);
+        pthread_cond_init(&executor->done, NULL);
+        pthread_cond_init(&executor->urgent_work, NULL);
+        executor->pending_urgent = 0;
+        executor->urgent.executor = executor;
+        executor->urgent.running = nullptr;
+        pthread_mutex_init(&executor->urgent.lock, NULL);
+        // the urgent thread only looks at its own deque, it starts first and the workers are counted as they start
+        int ret = pthread_create(&executor->urgent.thread, NULL, &urgent_worker, &executor->urgent);
+        if (ret) {
+            printf("ERROR: failed to create the urgent executor worker %d \n", ret);
+            pthread_mutex_destroy(&executor->urgent.lock);
+            pthread_mutex_destroy(&executor->lock);
+            pthread_cond_destroy(&executor->work);
+            pthread_cond_destroy(&executor->done);
+            pthread_cond_destroy(&executor->urgent_work);
+            return ret;
+        }
+        n_workers = std::max<uint32_t>(1, n_workers);
+        executor->workers = new struct ss_executor_worker[n_workers]();
+        for (uint32_t i = 0; i < n_workers; i++) {
+            executor->workers[i].executor = executor;
+            executor->workers[i].id = i;
+            pthread_mutex_init(&executor->workers[i].lock, NULL);
+        }
+        // the workers look at each other's deques, they all exist before the first one runs
+        executor->n_workers = n_workers;
+        for (uint32_t i = 0; i < n_workers; i++) {
+            ret = pthread_create(&executor->workers[i].thread, NULL, &executor_worker, &executor->workers[i]);
+            if (ret) {
+                printf("ERROR: failed to create executor worker %d \n", ret);
+                executor->n_workers = i;
+                ss_executor_free(executor);
+                return ret;
+            }
+        }
+        return 0;
+    }
+
+    void ss_executor_free(struct ss_executor *executor) {
+        pthread_mutex_lock(&executor->lock);
+        executor->stop = true;
+        executor->delayed.clear();
+        executor->next_due = 0;
+        pthread_cond_broadcast(&executor->work);
+        pthread_cond_broadcast(&executor->urgent_work);
+        pthread_mutex_unlock(&executor->lock);
+        for (uint32_t i = 0; i < executor->n_workers; i++) {
+            pthread_join(executor->workers[i].thread, NULL);
+            pthread_mutex_destroy(&executor->workers[i].lock);
+        }
+        pthread_join(executor->urgent.thread, NULL);
+        pthread_mutex_destroy(&executor->urgent.lock);
+        pthread_cond_destroy(&executor->urgent_work);
+        delete[] executor->workers;
+        executor->workers = nullptr;
+        executor->n_workers = 0;
+        pthread_mutex_destroy(&executor->lock);
+        pthread_cond_destroy(&executor->work);
+        pthread_cond_destroy(&executor->done);
+    }
+
+    void ss_executor_submit(struct ss_executor *executor, void (*fn)(void *), void *arg) {
+        struct ss_executor_worker *worker = current_worker;
+        if (worker == nullptr || worker->executor != executor) {
+            worker = &executor->workers[__atomic_fetch_add(&executor->next_worker, 1, __ATOMIC_RELAXED) % executor->n_workers];
+        }
+        // counted before it is queued, a worker may take it before the push returns
+        __atomic_add_fetch(&executor->pending, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_lock(&worker->lock);
+        worker->deque.push_back({fn, arg, 0});
+        pthread_mutex_unlock(&worker->lock);
+        if (__atomic_load_n(&executor->sleeping, __ATOMIC_SEQ_CST) > 0) {
+            pthread_mutex_lock(&executor->lock);
+            pthread_cond_signal(&executor->work);
+            pthread_mutex_unlock(&executor->lock);
+        }
+    }
+
+    void ss_executor_submit_urgent(struct ss_executor *executor, void (*fn)(void *), void *arg) {
+        __atomic_add_fetch(&executor->pending_urgent, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_lock(&executor->urgent.lock);
+        executor->urgent.deque.push_back({fn, arg, 0});
+        pthread_mutex_unlock(&executor->urgent.lock);
+        // the urgent thread is there for when every worker is busy, an idle worker is woken too
+        pthread_mutex_lock(&executor->lock);
+        pthread_cond_signal(&executor->urgent_work);
+        if (executor->sleeping > 0) {
+            pthread_cond_signal(&executor->work);
+        }
+        pthread_mutex_unlock(&executor->lock);
+    }
+
+    void ss_executor_submit_after(struct ss_executor *executor, void (*fn)(void *), void *arg, uint64_t delay_us) {
+        pthread_mutex_lock(&executor->lock);
+        executor->delayed.push_back({fn, arg, microseconds_since_epoch() + delay_us});
+        std::push_heap(executor->delayed.begin(), executor->delayed.end(), due_later);
+        __atomic_store_n(&executor->next_due, executor->delayed.front().due_us, __ATOMIC_RELAXED);
+        // a sleeping worker may wait for a later one
+        pthread_cond_signal(&executor->work);
+        pthread_mutex_unlock(&executor->lock);
+    }
+
+    // drop the tasks of arg from a deque, returns how many
+    static uint64_t drop_tasks(struct ss_executor_worker *worker, void *arg) {
+        pthread_mutex_lock(&worker->lock);
+        size_t before = worker->deque.size();
+        worker->deque.erase(std::remove_if(worker->deque.begin(), worker->deque.end(),
+                                           [arg](const struct ss_task &task) { return task.arg == arg; }),
+                            worker->deque.end());
+        uint64_t dropped = before - worker->deque.size();
+        pthread_mutex_unlock(&worker->lock);
+        return dropped;
+    }
+
+    void ss_executor_cancel(struct ss_executor *executor, void *arg) {
+        for (uint32_t i = 0; i < executor->n_workers; i++) {
+            __atomic_sub_fetch(&executor->pending, drop_tasks(&executor->workers[i], arg), __ATOMIC_SEQ_CST);
+        }
+        __atomic_sub_fetch(&executor->pending_urgent, drop_tasks(&executor->urgent, arg), __ATOMIC_SEQ_CST);
+        pthread_mutex_lock(&executor->lock);
+        executor->delayed.erase(std::remove_if(executor->delayed.begin(), executor->delayed.end(),
+                                               [arg](const struct ss_task &task) { return task.arg == arg; }),
+                                executor->delayed.end());
+        std::make_heap(executor->delayed.begin(), executor->delayed.end(), due_later);
+        __atomic_store_n(&executor->next_due, executor->delayed.empty() ? 0 : executor->delayed.front().due_us, __ATOMIC_RELAXED);
+        // a task taken before its deque was looked at has running set already, see take_task
+        __atomic_add_fetch(&executor->cancelling, 1, __ATOMIC_SEQ_CST);
+        while (true) {
+            bool running = __atomic_load_n(&executor->urgent.running, __ATOMIC_SEQ_CST) == arg &&
+                           executor->urgent.thread != pthread_self();
+            for (uint32_t i = 0; i < executor->n_workers; i++) {
+                running |= __atomic_load_n(&executor->workers[i].running, __ATOMIC_SEQ_CST) == arg &&
+                           executor->workers[i].thread != pthread_self();
+            }
+            if (!running) {
+                break;
+            }
+            pthread_cond_wait(&executor->done, &executor->lock);
+        }
+        __atomic_sub_fetch(&executor->cancelling, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&executor->lock);
+    }
+}
@@ -0,0 +1,103 @@
+/*
+* MIT License
+Copyright (c) 2021 - current
+Authors: Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef STOSYS_PROJECT_EXECUTOR_H
+#define STOSYS_PROJECT_EXECUTOR_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+extern "C" {
+/*
+ * Task executor for the background work of the FTL (GC passes, zone resets), shared by every FTL
+ * instance of the process. Each worker thread has a deque of tasks behind a lock of its own: a task
+ * submitted by a worker goes to the back of its own deque, one from any other thread round robin to the
+ * workers. A worker takes its newest task first and when its deque is empty steals the oldest task of
+ * another worker. The executor lock is only taken to sleep and wake workers and for the delayed tasks,
+ * which may be submitted to run after a delay.
+ * Urgent tasks, the ones a thread holding an FTL lock may wait for, go to a deque of their own: every
+ * worker takes them before any other task, and one more thread runs only them, so they also run while
+ * all workers are blocked in tasks that wait on that lock.
+ * A task must not wait for another task to finish, there may be fewer workers than waiting tasks. Only
+ * urgent tasks may be waited for, and they must not wait on anything a waiter holds.
+ */
+struct ss_task {
+    void (*fn)(void *);
+    void *arg;
+    // when a delayed task is due, microseconds since the epoch
+    uint64_t due_us;
+};
+
+struct ss_executor;
+
+struct ss_executor_worker {
+    struct ss_executor *executor;
+    uint32_t id;
+    pthread_t thread;
+    // guards the deque, taken after the executor lock when both are held
+    pthread_mutex_t lock;
+    std::deque<struct ss_task> deque;
+    // the arg of the task the worker runs, nullptr when it runs none. Set under the lock of the deque the
+    // task came from, so a cancel that finds the task gone also sees it run (atomic)
+    void *running;
+};
+
+struct ss_executor {
+    struct ss_executor_worker *workers;
+    uint32_t n_workers;
+    // sleep and wake of the workers, and the delayed tasks
+    pthread_mutex_t lock;
+    // a task was queued or a delayed one came in, and a task finished
+    pthread_cond_t work;
+    pthread_cond_t done;
+    // tasks in the deques, workers asleep on work, and cancels that wait on done (atomic)
+    uint64_t pending;
+    uint32_t sleeping;
+    uint32_t cancelling;
+    // delayed tasks, a heap on due_us, and when the first one is due, 0 if none (read atomic)
+    std::vector<struct ss_task> delayed;
+    uint64_t next_due;
+    uint32_t next_worker;
+    bool stop;
+    // tasks run, and how many of them were stolen from another worker (atomic)
+    uint64_t executed;
+    uint64_t stolen;
+    // the urgent deque and the thread that runs only that, it sleeps on urgent_work. Urgent tasks queued (atomic)
+    struct ss_executor_worker urgent;
+    pthread_cond_t urgent_work;
+    uint64_t pending_urgent;
+};
+
+int ss_executor_init(struct ss_executor *executor, uint32_t n_workers);
+// the workers finish what is queued, delayed tasks are dropped
+void ss_executor_free(struct ss_executor *executor);
+void ss_executor_submit(struct ss_executor *executor, void (*fn)(void *), void *arg);
+// run ahead of every task submitted the usual way
+void ss_executor_submit_urgent(struct ss_executor *executor, void (*fn)(void *), void *arg);
+void ss_executor_submit_after(struct ss_executor *executor, void (*fn)(void *), void *arg, uint64_t delay_us);
+// drop the queued and delayed tasks of arg and wait for the ones that run, no task of arg runs after this
+void ss_executor_cancel(struct ss_executor *executor, void *arg);
+}
+
+#endif //STOSYS_PROJECT_EXECUTOR_H
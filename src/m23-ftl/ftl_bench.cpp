@@ -0,0 +1,293 @@
+/*
+ * MIT License
+Copyright (c) 2021 - current
+Authors:  Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+
+#include <cstdio>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "zns_device.h"
+#include "bench/bench.h"
+
+// FTL benchmark: the device is filled once, then overwritten with a skewed workload (hot_pct of
+// the writes go to hot_space_pct of the LBAs). The same workload runs once per FTL configuration,
+// -m picks what the runs compare. Most modes compare a base run against a changed one with bench_compare,
+// they only set the runs up and print them (bench/compare.cpp), the others live in bench/<mode>.cpp. The fill,
+// the workloads and the read back that checks the device holds what was written are shared, in bench/bench.cpp.
+
+struct bench_mode {
+    const char *name;
+    // a mode that runs on its own, or the two runs bench_compare makes and their names
+    int (*run)(struct bench_options *opts, struct zdev_init_params *params);
+    bench_configure_fn configure;
+    bench_print_fn print;
+    const char *names[2];
+    // the overwrites are mixed with reads unless -r says otherwise
+    bool reads;
+    // devices the mode needs at least
+    size_t min_devices;
+};
+
+static const struct bench_mode modes[] = {
+        {"hotcold", nullptr, bench_hotcold_configure, bench_hotcold_print, {"mixed", "hot/cold"}, false, 1},
+        {"copy", nullptr, bench_copy_configure, bench_copy_print, {"host-copy", "offload"}, false, 1},
+        {"qos", nullptr, bench_qos_configure, bench_qos_print, {"on-demand", "background"}, true, 1},
+        {"gc", bench_gc, nullptr, nullptr, {}, false, 1},
+        {"wear", nullptr, bench_wear_configure, bench_wear_print, {"no-wl", "static-wl"}, false, 1},
+        {"age", nullptr, bench_age_configure, bench_age_print, {"merge", "age-sort"}, false, 1},
+        {"trim", nullptr, bench_trim_configure, bench_trim_print, {"dead", "trimmed"}, false, 1},
+        {"hint", nullptr, bench_hint_configure, bench_hint_print, {"no-hints", "hints"}, false, 1},
+        {"zero", nullptr, bench_zero_configure, bench_zero_print, {"data", "zeroes"}, false, 1},
+        {"compress", nullptr, bench_compress_configure, bench_compress_print, {"plain", "compressed"}, false, 1},
+        {"dedup", nullptr, bench_dedup_configure, bench_dedup_print, {"plain", "dedup"}, false, 1},
+        {"checksum", bench_checksum, nullptr, nullptr, {}, true, 1},
+        {"backpressure", nullptr, bench_backpressure_configure, bench_backpressure_print, {"blocking", "nonblock"}, false, 1},
+        {"adaptive", bench_adaptive, nullptr, nullptr, {}, false, 1},
+        {"chunk", bench_chunk, nullptr, nullptr, {}, false, 1},
+        {"multi", bench_multi, nullptr, nullptr, {}, false, 2},
+        {"stripe", nullptr, bench_stripe_configure, bench_stripe_print, {"one-device", "volume"}, false, 2},
+        {"shard", nullptr, bench_shard_configure, bench_shard_print, {"one-ftl", "sharded"}, false, 1},
+};
+
+static int show_help(){
+    printf("Usage: ftl_bench -d device_name -h \n");
+    printf("-d : /dev/nvmeXpY - in this format with the full path, repeat it to give the devices for -m multi \n");
+    printf("-l : the number of zones to use for log/metadata (default, minimum = 3). \n");
+    printf("-w : watermark threshold, the gc runs when a write would leave fewer free log zones (default, minimum = 1). \n");
+    printf("-m : what to compare, hotcold (hot/cold separation, default), copy (GC copy offload), qos (background GC), gc (GC victim policies), wear (static wear leveling) age (GC age sorting), trim (trimming dead data), hint (lifetime hints), zero (all-zero blocks), compress (log compression), dedup (deduplication), checksum (block checksums), backpressure (non-blocking writes), adaptive (adaptive background GC), chunk (sub-zone chunk merges), multi (several devices, alone and at once), stripe (one device against a volume striped over all of them) or shard (concurrent writers on one FTL and on a sharded one). \n");
+    printf("-a : age buckets for -m age (default, 2). \n");
+    printf("-z : percentage of the overwrites that are all-zero blocks for -m zero (default, 25). \n");
+    printf("-b : LBAs per read and overwrite for -m compress, -m dedup, -m checksum and -m stripe (default, 8, and a stripe on every device for -m stripe). \n");
+    printf("-k : stripe unit in LBAs for -m stripe (default, 32). \n");
+    printf("-j : shards, and writer threads, for -m shard, every shard has -l log zones (default, 4). \n");
+    printf("-y : chunk size in LBAs for -m chunk, the chunk area has as many zones as the log (default, 16). \n");
+    printf("-o : LBAs per burst for -m adaptive (default, 1024). \n");
+    printf("-i : quiet time after every burst in us for -m adaptive (default, 20000). \n");
+    printf("-x : worker threads of the background executor that runs GC and zone resets, in every mode (default, 2). \n");
+    printf("-c : percentage of every block written that is random, incompressible, for -m compress, -m dedup and -m checksum (default, 50). \n");
+    printf("-u : percentage of the blocks written that repeat earlier content for -m dedup (default, 50). \n");
+    printf("-t : percentage of the LBAs that are dead after the fill for -m trim (default, 50). \n");
+    printf("-e : reset gap at which static wear leveling moves data for -m wear (default, 4). \n");
+    printf("-g : background GC share of the device I/O in percent for -m qos and -m adaptive (default, 20). \n");
+    printf("-q : for -m qos, compare background GC without and with this I/O scheduling mode, 1 = weighted, 2 = strict (default, 0 = compare with on-demand GC). \n");
+    printf("-r : percentage of the commands after the fill that are reads (default, 0, and 50 for -m qos). \n");
+    printf("-n : number of LBAs overwritten after the fill (default, 4x the device LBAs). \n");
+    printf("-p : percentage of the writes that go to the hot set (default, 80). \n");
+    printf("-s : percentage of the LBAs in the hot set (default, 20). \n");
+    printf("-h : shows help, and exits with success. No argument needed\n");
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int ret, c;
+    char *zns_device_name = (char*) "nvme0n1";
+    const struct bench_mode *mode = &modes[0];
+    struct bench_options opts{};
+    opts.hot_pct = 80;
+    opts.hot_space_pct = 20;
+    opts.seed = 42;
+    opts.age_buckets = 2;
+    opts.dead_pct = 50;
+    opts.zero_pct = 25;
+    opts.random_pct = 50;
+    opts.dup_pct = 50;
+    opts.stripe_blocks = 32;
+    opts.shards = 4;
+    opts.burst_blocks = 1024;
+    opts.pause_us = 20000;
+    opts.chunk_blocks = 16;
+    opts.wear_gap = 4;
+    opts.read_pct = -1;
+    opts.gc_bw_pct = 20;
+
+    struct zdev_init_params params{};
+    params.force_reset = true;
+    params.log_zones = 3;
+    params.gc_wmark = 1;
+
+    while ((c = getopt(argc, argv, "d:l:w:m:n:p:s:g:q:r:e:a:t:z:b:c:u:k:j:x:o:i:y:h")) != -1) {
+        switch (c) {
+            case 'h':
+                show_help();
+                exit(0);
+            case 'd': {
+                // keep the last path component, /dev/nvme0n1 -> nvme0n1
+                char *slash = strrchr(optarg, '/');
+                zns_device_name = strdup(slash ? slash + 1 : optarg);
+                opts.device_names.push_back(zns_device_name);
+                break;
+            }
+            case 'l':
+                params.log_zones = atoi(optarg);
+                if (params.log_zones < 3){
+                    printf("you need 3 or more zones for the log area. You passed %d \n", params.log_zones);
+                    exit(-1);
+                }
+                break;
+            case 'w':
+                params.gc_wmark = atoi(optarg);
+                if (params.gc_wmark < 1){
+                    printf("you need 1 or more free zones for continuous working of the FTL. You passed %d \n", params.gc_wmark);
+                    exit(-1);
+                }
+                break;
+            case 'm':
+                mode = nullptr;
+                for (const struct bench_mode &m : modes) {
+                    if (strcmp(optarg, m.name) == 0) {
+                        mode = &m;
+                    }
+                }
+                if (mode == nullptr) {
+                    printf("unknown mode %s \n", optarg);
+                    exit(-1);
+                }
+                break;
+            case 'g':
+                opts.gc_bw_pct = atoi(optarg);
+                break;
+            case 'q':
+                opts.io_sched = atoi(optarg);
+                break;
+            case 'e':
+                opts.wear_gap = atoi(optarg);
+                break;
+            case 'a':
+                opts.age_buckets = atoi(optarg);
+                break;
+            case 'z':
+                opts.zero_pct = atoi(optarg);
+                break;
+            case 'b':
+                opts.io_blocks = atoi(optarg);
+                if (opts.io_blocks < 1) {
+                    printf("an overwrite needs 1 or more LBAs. You passed %u \n", opts.io_blocks);
+                    exit(-1);
+                }
+                break;
+            case 'k':
+                opts.stripe_blocks = atoi(optarg);
+                if (opts.stripe_blocks < 1) {
+                    printf("a stripe needs 1 or more LBAs. You passed %u \n", opts.stripe_blocks);
+                    exit(-1);
+                }
+                break;
+            case 'j':
+                opts.shards = atoi(optarg);
+                if (opts.shards < 2) {
+                    printf("sharding needs 2 or more opts.shards. You passed %u \n", opts.shards);
+                    exit(-1);
+                }
+                break;
+            case 'o':
+                opts.burst_blocks = atoi(optarg);
+                if (opts.burst_blocks < 1) {
+                    printf("a burst needs 1 or more LBAs. You passed %u \n", opts.burst_blocks);
+                    exit(-1);
+                }
+                break;
+            case 'i':
+                opts.pause_us = atoi(optarg);
+                break;
+            case 'y':
+                opts.chunk_blocks = atoi(optarg);
+                if (opts.chunk_blocks < 1) {
+                    printf("a chunk needs 1 or more LBAs. You passed %u \n", opts.chunk_blocks);
+                    exit(-1);
+                }
+                break;
+            case 'x':
+                params.bg_threads = atoi(optarg);
+                if (params.bg_threads < 1) {
+                    printf("the executor needs 1 or more threads. You passed %u \n", params.bg_threads);
+                    exit(-1);
+                }
+                break;
+            case 'c':
+                opts.random_pct = atoi(optarg);
+                if (opts.random_pct < 0 || opts.random_pct > 100) {
+                    printf("the random percentage has to be between 0 and 100. You passed %d \n", opts.random_pct);
+                    exit(-1);
+                }
+                break;
+            case 'u':
+                opts.dup_pct = atoi(optarg);
+                if (opts.dup_pct < 0 || opts.dup_pct > 100) {
+                    printf("the repeated percentage has to be between 0 and 100. You passed %d \n", opts.dup_pct);
+                    exit(-1);
+                }
+                break;
+            case 't':
+                opts.dead_pct = atoi(optarg);
+                if (opts.dead_pct < 0 || opts.dead_pct > 99) {
+                    printf("the dead percentage has to be between 0 and 99. You passed %d \n", opts.dead_pct);
+                    exit(-1);
+                }
+                break;
+            case 'r':
+                opts.read_pct = atoi(optarg);
+                break;
+            case 'n':
+                opts.n_writes = strtoull(optarg, nullptr, 10);
+                break;
+            case 'p':
+                opts.hot_pct = atoi(optarg);
+                break;
+            case 's':
+                opts.hot_space_pct = atoi(optarg);
+                break;
+            default:
+                show_help();
+                exit(-1);
+        }
+    }
+    if (opts.device_names.empty()) {
+        opts.device_names.push_back(zns_device_name);
+    }
+    if (opts.device_names.size() < mode->min_devices) {
+        printf("-m %s needs %zu or more devices, pass -d for each. You passed %zu \n", mode->name, mode->min_devices,
+               opts.device_names.size());
+        exit(-1);
+    }
+    params.name = strdup(opts.device_names[0]);
+    if (opts.n_writes == 0) {
+        // size the run from the device itself
+        struct user_zns_device *my_dev = nullptr;
+        ret = init_ss_zns_device(&params, &my_dev);
+        assert(ret == 0);
+        opts.n_writes = 4 * (my_dev->capacity_bytes / my_dev->lba_size_bytes);
+        deinit_ss_zns_device(my_dev);
+    }
+    if (opts.io_blocks == 0) {
+        opts.io_blocks = mode->configure == bench_stripe_configure ? opts.stripe_blocks * opts.device_names.size() : 8;
+    }
+    if (opts.read_pct < 0) {
+        opts.read_pct = mode->reads ? 50 : 0;
+    }
+    printf("parameter settings are: device-name %s log_zones %d gc-watermark %d writes %lu hot %d%% of writes to %d%% of LBAs \n",
+           params.name, params.log_zones, params.gc_wmark, opts.n_writes, opts.hot_pct, opts.hot_space_pct);
+    if (mode->run) {
+        return mode->run(&opts, &params);
+    }
+    return bench_compare(&opts, &params, mode->configure, mode->print, mode->names);
+}
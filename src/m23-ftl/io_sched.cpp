@@ -0,0 +1,328 @@
+/*
+* MIT License
+Copyright (c) 2021 - current
+Authors: Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "io_sched.h"
+
+extern "C" {
+
+    enum { SS_IO_OP_READ, SS_IO_OP_WRITE, SS_IO_OP_APPEND, SS_IO_OP_CMD };
+
+    // the submitter sleeps on this until every request it queued is done
+    struct ss_io_wait {
+        pthread_cond_t cond;
+        uint32_t pending;
+    };
+
+    struct ss_io_req {
+        int io_class;
+        int op;
+        uint64_t slba;
+        uint32_t nlb;
+        void *buf;
+        __u64 *result;
+        int (*fn)(void *);
+        void *arg;
+        int status;
+        struct ss_io_wait *wait;
+    };
+
+    // default weights: user reads and writes get most, metadata more than GC
+    static const uint32_t default_weights[SS_IO_N_CLASSES] = {8, 4, 2, 1};
+    static const uint32_t MERGE_WINDOW = 32;
+
+    static int run_one(struct ss_io_sched *sched, struct ss_io_req *req) {
+        switch (req->op) {
+            case SS_IO_OP_READ:
+                return nvme_read(sched->fd, sched->nsid, req->slba, req->nlb - 1, 0, 0, 0, 0, 0,
+                                 req->nlb * sched->lba_size, req->buf, 0, NULL);
+            case SS_IO_OP_WRITE:
+                return nvme_write(sched->fd, sched->nsid, req->slba, req->nlb - 1, 0, 0, 0, 0, 0, 0,
+                                  req->nlb * sched->lba_size, req->buf, 0, NULL);
+            case SS_IO_OP_APPEND:
+                return nvme_zns_append(sched->fd, sched->nsid, req->slba, req->nlb - 1, 0, 0, 0, 0,
+                                       req->nlb * sched->lba_size, req->buf, 0, NULL, req->result);
+            default:
+                return req->fn(req->arg);
+        }
+    }
+
+    // run a read or write together with the ones that continue it, through one bounce buffer
+    static int run_merged(struct ss_io_sched *sched, std::vector<struct ss_io_req *> &batch, uint32_t nlb) {
+        char *bounce = (char *)malloc((uint64_t)nlb * sched->lba_size);
+        if (bounce == nullptr) {
+            return -ENOMEM;
+        }
+        bool read = batch[0]->op == SS_IO_OP_READ;
+        uint64_t off = 0;
+        int ret;
+        if (read) {
+            ret = nvme_read(sched->fd, sched->nsid, batch[0]->slba, nlb - 1, 0, 0, 0, 0, 0, nlb * sched->lba_size, bounce, 0, NULL);
+        } else {
+            for (auto *req : batch) {
+                memcpy(bounce + off, req->buf, (uint64_t)req->nlb * sched->lba_size);
+                off += (uint64_t)req->nlb * sched->lba_size;
+            }
+            ret = nvme_write(sched->fd, sched->nsid, batch[0]->slba, nlb - 1, 0, 0, 0, 0, 0, 0, nlb * sched->lba_size, bounce, 0, NULL);
+        }
+        if (read && ret == 0) {
+            for (auto *req : batch) {
+                memcpy(req->buf, bounce + off, (uint64_t)req->nlb * sched->lba_size);
+                off += (uint64_t)req->nlb * sched->lba_size;
+            }
+        }
+        free(bounce);
+        return ret;
+    }
+
+    // next class to serve, -1 if every queue is empty. Called with the lock held
+    static int pick_class(struct ss_io_sched *sched) {
+        int pick = -1;
+        for (int c = 0; c < SS_IO_N_CLASSES; c++) {
+            if (sched->queue[c].empty()) {
+                continue;
+            }
+            if (sched->mode == SS_IO_SCHED_STRICT) {
+                return c;
+            }
+            if (pick == -1 || sched->vtime[c] < sched->vtime[pick]) {
+                pick = c;
+            }
+        }
+        return pick;
+    }
+
+    // take the head of a queue and the requests close behind it that continue it on the device,
+    // returns the LBAs of the batch. Called with the lock held
+    static uint32_t take_batch(struct ss_io_sched *sched, int c, std::vector<struct ss_io_req *> &batch) {
+        std::deque<struct ss_io_req *> &queue = sched->queue[c];
+        struct ss_io_req *head = queue.front();
+        queue.pop_front();
+        batch.push_back(head);
+        uint32_t nlb = head->nlb;
+        if (head->op != SS_IO_OP_READ && head->op != SS_IO_OP_WRITE) {
+            return nlb;
+        }
+        bool found = true;
+        while (found) {
+            found = false;
+            size_t window = std::min<size_t>(queue.size(), sched->merge_window);
+            for (size_t i = 0; i < window; i++) {
+                struct ss_io_req *req = queue[i];
+                if (req->op == head->op && req->slba == head->slba + nlb && nlb + req->nlb <= sched->max_blocks) {
+                    batch.push_back(req);
+                    nlb += req->nlb;
+                    queue.erase(queue.begin() + i);
+                    found = true;
+                    break;
+                }
+            }
+        }
+        return nlb;
+    }
+
+    static void *io_worker(void *args) {
+        struct ss_io_sched *sched = (struct ss_io_sched *)args;
+        std::vector<struct ss_io_req *> batch;
+        pthread_mutex_lock(&sched->lock);
+        while (true) {
+            int c = pick_class(sched);
+            if (c == -1) {
+                if (sched->stop) {
+                    break;
+                }
+                pthread_cond_wait(&sched->work, &sched->lock);
+                continue;
+            }
+            batch.clear();
+            uint32_t nlb = take_batch(sched, c, batch);
+            sched->vtime[c] += (double)std::max<uint32_t>(nlb, 1) / sched->weight[c];
+            sched->dispatched[c]++;
+            sched->merged[c] += batch.size() - 1;
+            pthread_mutex_unlock(&sched->lock);
+
+            int ret = batch.size() == 1 ? run_one(sched, batch[0]) : run_merged(sched, batch, nlb);
+
+            pthread_mutex_lock(&sched->lock);
+            for (auto *req : batch) {
+                req->status = ret;
+                if (--req->wait->pending == 0) {
+                    pthread_cond_signal(&req->wait->cond);
+                }
+            }
+        }
+        pthread_mutex_unlock(&sched->lock);
+        return (void *)0;
+    }
+
+    // queue n requests of one class and wait for all of them, returns the first error
+    static int submit(struct ss_io_sched *sched, struct ss_io_req *reqs, uint32_t n) {
+        int ret = 0;
+        if (sched->n_workers == 0) {
+            for (uint32_t i = 0; i < n && ret == 0; i++) {
+                ret = run_one(sched, &reqs[i]);
+            }
+            return ret;
+        }
+
+        struct ss_io_wait wait{};
+        pthread_cond_init(&wait.cond, NULL);
+        wait.pending = n;
+        int io_class = reqs[0].io_class;
+        pthread_mutex_lock(&sched->lock);
+        // a class coming back from idle starts level with the busiest others, it can not claim the time it missed
+        if (sched->queue[io_class].empty()) {
+            double floor = -1;
+            for (int c = 0; c < SS_IO_N_CLASSES; c++) {
+                if (!sched->queue[c].empty() && (floor < 0 || sched->vtime[c] < floor)) {
+                    floor = sched->vtime[c];
+                }
+            }
+            sched->vtime[io_class] = std::max(sched->vtime[io_class], floor);
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            reqs[i].wait = &wait;
+            sched->queue[io_class].push_back(&reqs[i]);
+        }
+        pthread_cond_broadcast(&sched->work);
+        while (wait.pending > 0) {
+            pthread_cond_wait(&wait.cond, &sched->lock);
+        }
+        pthread_mutex_unlock(&sched->lock);
+        pthread_cond_destroy(&wait.cond);
+        for (uint32_t i = 0; i < n && ret == 0; i++) {
+            ret = reqs[i].status;
+        }
+        return ret;
+    }
+
+    int ss_io_sched_init(struct ss_io_sched *sched, int fd, uint32_t nsid, uint32_t lba_size, uint32_t max_bytes,
+                         int mode, const uint32_t *weights, uint32_t n_workers) {
+        sched->fd = fd;
+        sched->nsid = nsid;
+        sched->lba_size = lba_size;
+        sched->max_blocks = std::max<uint32_t>(1, max_bytes / lba_size);
+        sched->merge_window = MERGE_WINDOW;
+        sched->mode = mode;
+        for (int c = 0; c < SS_IO_N_CLASSES; c++) {
+            sched->weight[c] = (weights != nullptr && weights[c] != 0) ? weights[c] : default_weights[c];
+            sched->vtime[c] = 0;
+            sched->dispatched[c] = sched->merged[c] = 0;
+        }
+        sched->stop = false;
+        sched->workers = nullptr;
+        sched->n_workers = 0;
+        pthread_mutex_init(&sched->lock, NULL);
+        pthread_cond_init(&sched->work, NULL);
+        if (mode == SS_IO_SCHED_OFF) {
+            return 0;
+        }
+
+        sched->workers = (pthread_t *)calloc(n_workers, sizeof(pthread_t));
+        for (uint32_t i = 0; i < n_workers; i++) {
+            int ret = pthread_create(&sched->workers[i], NULL, &io_worker, sched);
+            if (ret) {
+                printf("ERROR: failed to create I/O worker %d \n", ret);
+                ss_io_sched_free(sched);
+                return ret;
+            }
+            sched->n_workers++;
+        }
+        return 0;
+    }
+
+    // the workers finish what is queued, then exit
+    void ss_io_sched_free(struct ss_io_sched *sched) {
+        pthread_mutex_lock(&sched->lock);
+        sched->stop = true;
+        pthread_cond_broadcast(&sched->work);
+        pthread_mutex_unlock(&sched->lock);
+        for (uint32_t i = 0; i < sched->n_workers; i++) {
+            pthread_join(sched->workers[i], NULL);
+        }
+        free(sched->workers);
+        sched->workers = nullptr;
+        sched->n_workers = 0;
+        pthread_mutex_destroy(&sched->lock);
+        pthread_cond_destroy(&sched->work);
+    }
+
+    static int submit_one(struct ss_io_sched *sched, int io_class, int op, uint64_t slba, uint32_t nlb, void *buf) {
+        struct ss_io_req req{};
+        req.io_class = io_class;
+        req.op = op;
+        req.slba = slba;
+        req.nlb = nlb;
+        req.buf = buf;
+        return submit(sched, &req, 1);
+    }
+
+    int ss_io_read(struct ss_io_sched *sched, int io_class, uint64_t slba, uint32_t nlb, void *buf) {
+        return submit_one(sched, io_class, SS_IO_OP_READ, slba, nlb, buf);
+    }
+
+    int ss_io_write(struct ss_io_sched *sched, int io_class, uint64_t slba, uint32_t nlb, void *buf) {
+        return submit_one(sched, io_class, SS_IO_OP_WRITE, slba, nlb, buf);
+    }
+
+    int ss_io_readv(struct ss_io_sched *sched, int io_class, struct ss_io_vec *vec, uint32_t n) {
+        if (n == 0) {
+            return 0;
+        }
+        std::vector<struct ss_io_req> reqs(n);
+        for (uint32_t i = 0; i < n; i++) {
+            reqs[i] = {};
+            reqs[i].io_class = io_class;
+            reqs[i].op = SS_IO_OP_READ;
+            reqs[i].slba = vec[i].slba;
+            reqs[i].nlb = vec[i].nlb;
+            reqs[i].buf = vec[i].buf;
+        }
+        return submit(sched, reqs.data(), n);
+    }
+
+    int ss_io_append(struct ss_io_sched *sched, int io_class, uint64_t zslba, uint32_t nlb, void *buf, __u64 *result) {
+        struct ss_io_req req{};
+        req.io_class = io_class;
+        req.op = SS_IO_OP_APPEND;
+        req.slba = zslba;
+        req.nlb = nlb;
+        req.buf = buf;
+        req.result = result;
+        return submit(sched, &req, 1);
+    }
+
+    int ss_io_cmd(struct ss_io_sched *sched, int io_class, int (*fn)(void *), void *arg) {
+        struct ss_io_req req{};
+        req.io_class = io_class;
+        req.op = SS_IO_OP_CMD;
+        req.fn = fn;
+        req.arg = arg;
+        return submit(sched, &req, 1);
+    }
+}
@@ -0,0 +1,101 @@
+/*
+* MIT License
+Copyright (c) 2021 - current
+Authors: Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef STOSYS_PROJECT_IO_SCHED_H
+#define STOSYS_PROJECT_IO_SCHED_H
+
+#include <cstdint>
+#include <deque>
+#include <pthread.h>
+#include <libnvme.h>
+
+extern "C" {
+/*
+ * FTL-internal I/O scheduler. Every device command of the FTL is submitted here with the class of
+ * traffic it belongs to and waits for its completion. Each class has its own queue, worker threads
+ * take the next command from the queues either by strict priority (lower class first) or by weight
+ * (every class gets a share of the dispatched blocks in proportion to its weight). Reads and writes
+ * queued in the same class that continue each other are merged into one device command.
+ * With no workers there is no queueing at all, commands run right away in the caller.
+ */
+enum ss_io_class {
+    SS_IO_USER_READ = 0,
+    SS_IO_USER_WRITE,
+    // zone management and zone reports
+    SS_IO_META,
+    SS_IO_GC,
+    SS_IO_N_CLASSES
+};
+
+enum ss_io_mode {
+    SS_IO_SCHED_OFF = 0,
+    SS_IO_SCHED_WEIGHTED,
+    SS_IO_SCHED_STRICT
+};
+
+struct ss_io_req;
+
+// one piece of a vectored request
+struct ss_io_vec {
+    uint64_t slba;
+    uint32_t nlb;
+    void *buf;
+};
+
+struct ss_io_sched {
+    int fd;
+    uint32_t nsid;
+    uint32_t lba_size;
+    // largest merged command, in LBAs
+    uint32_t max_blocks;
+    // how deep into a queue to look for a request that continues the head
+    uint32_t merge_window;
+    int mode;
+    uint32_t weight[SS_IO_N_CLASSES];
+    // blocks dispatched per class, scaled by the weight (weighted mode)
+    double vtime[SS_IO_N_CLASSES];
+    std::deque<struct ss_io_req *> queue[SS_IO_N_CLASSES];
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_t *workers;
+    uint32_t n_workers;
+    bool stop;
+    // commands that reached the device, and requests that rode along in a merged one
+    uint64_t dispatched[SS_IO_N_CLASSES];
+    uint64_t merged[SS_IO_N_CLASSES];
+};
+
+// weights may be nullptr or hold 0s, those take the defaults
+int ss_io_sched_init(struct ss_io_sched *sched, int fd, uint32_t nsid, uint32_t lba_size, uint32_t max_bytes,
+                     int mode, const uint32_t *weights, uint32_t n_workers);
+void ss_io_sched_free(struct ss_io_sched *sched);
+
+int ss_io_read(struct ss_io_sched *sched, int io_class, uint64_t slba, uint32_t nlb, void *buf);
+int ss_io_write(struct ss_io_sched *sched, int io_class, uint64_t slba, uint32_t nlb, void *buf);
+// all pieces are queued at once, so the ones that are adjacent on the device can be merged
+int ss_io_readv(struct ss_io_sched *sched, int io_class, struct ss_io_vec *vec, uint32_t n);
+int ss_io_append(struct ss_io_sched *sched, int io_class, uint64_t zslba, uint32_t nlb, void *buf, __u64 *result);
+// any other command, fn(arg) is run by a worker in the turn of the class
+int ss_io_cmd(struct ss_io_sched *sched, int io_class, int (*fn)(void *), void *arg);
+}
+
+#endif //STOSYS_PROJECT_IO_SCHED_H
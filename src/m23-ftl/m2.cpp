@@ -115,7 +115,7 @@ int main(int argc, char **argv) {
     int ret, c, buffer_size = 1U << 20; // 1MB is the default size 
     char *zns_device_name = (char*) "nvme0n1", *test_buf = nullptr, *str1 = nullptr;
     struct user_zns_device *my_dev = nullptr;
-    struct zdev_init_params params;
+    struct zdev_init_params params{};
     params.force_reset = true;
     params.log_zones = 3;
     params.gc_wmark = 1;
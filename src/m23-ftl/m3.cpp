@@ -201,8 +201,18 @@ static int show_help(){
     printf("-d : /dev/nvmeXpY - in this format with the full path \n");
     printf("-r : resume if the FTL can. \n");
     printf("-l : the number of zones to use for log/metadata (default, minimum = 3). \n");
-    printf("-w : watermark threshold, the number of free zones when to trigger the gc (default, minimum = 1). \n");
+    printf("-w : watermark threshold, the gc runs when a write would leave fewer free log zones (default, minimum = 1). \n");
     printf("-o : overwrite so [int] times  (default, 10,000). \n");
+    printf("-c : verify the FTL zone mirror against the device after every GC pass. \n");
+    printf("-t : separate hot and cold writes into their own log zones. \n");
+    printf("-g : run GC in the background with at most [int] percent of the device I/O (default, 0 = off). \n");
+    printf("-y : let GC move blocks with NVMe Copy when the device supports it. \n");
+    printf("-f : start background GC as early as the write rate needs, and clean ahead when idle. \n");
+    printf("-p : GC victim policy, 0 = greedy, 1 = cost-benefit, 2 = age threshold, 3 = FIFO (default, 0). \n");
+    printf("-e : move cold data off the least worn zones once they are [int] resets behind (default, 0 = off). \n");
+    printf("-a : sort blocks GC moves into [int] age buckets of GC log zones, at most 3 (default, 0 = always merge). \n");
+    printf("-k : map data zones in chunks of [int] LBAs too, merges rewrite only the chunks that changed (default, 0 = off). \n");
+    printf("-s : device I/O scheduling, 0 = none, 1 = weighted per class, 2 = strict priority (default, 0). \n");
     printf("-h : shows help, and exits with success. No argument needed\n");
     return 0;
 }
@@ -217,7 +227,7 @@ int main(int argc, char **argv) {
     uint64_t *seq_addresses = nullptr, *random_addresses = nullptr;
     uint32_t to_hammer_lba = 10000;
 
-    struct zdev_init_params params;
+    struct zdev_init_params params{};
     params.force_reset = true;
     params.log_zones = 3;
     params.gc_wmark = 1;
@@ -226,7 +236,7 @@ int main(int argc, char **argv) {
     printf("This is M3. The goal of this milestone is to implement a hybrid log-structure ZTL (Zone Translation Layer) on top of the ZNS WITH a GC \n");
     printf("                                                                                                                             ^^^^^^^^^ \n");
     printf("===================================================================================== \n");
-    while ((c = getopt(argc, argv, "o:m:l:d:w:hr")) != -1) {
+    while ((c = getopt(argc, argv, "o:m:l:d:w:g:s:p:e:a:k:hrctfy")) != -1) {
         switch (c) {
             case 'h':
                 show_help();
@@ -234,6 +244,36 @@ int main(int argc, char **argv) {
             case 'r':
                 params.force_reset = false;
                 break;
+            case 'c':
+                params.zone_check = true;
+                break;
+            case 't':
+                params.hot_cold = true;
+                break;
+            case 'g':
+                params.gc_bw_pct = atoi(optarg);
+                break;
+            case 'f':
+                params.gc_adaptive = true;
+                break;
+            case 'y':
+                params.copy_offload = true;
+                break;
+            case 's':
+                params.io_sched = atoi(optarg);
+                break;
+            case 'p':
+                params.gc_policy = atoi(optarg);
+                break;
+            case 'e':
+                params.wear_gap = atoi(optarg);
+                break;
+            case 'a':
+                params.gc_age_buckets = atoi(optarg);
+                break;
+            case 'k':
+                params.chunk_blocks = atoi(optarg);
+                break;
             case 'o':
                 to_hammer_lba = atoi(optarg);
                 break;
@@ -204,7 +204,7 @@ static int show_help(){
     printf("-d : /dev/nvmeXpY - in this format with the full path \n");
     printf("-r : resume if the FTL can. \n");
     printf("-l : the number of zones to use for log/metadata (default, minimum = 3). \n");
-    printf("-w : watermark threshold, the number of free zones when to trigger the gc (default, minimum = 1). \n");
+    printf("-w : watermark threshold, the gc runs when a write would leave fewer free log zones (default, minimum = 1). \n");
     printf("-o : overwrite so [int] times  (default, 10,000). \n");
     printf("-h : shows help, and exits with success. No argument needed\n");
     return 0;
@@ -220,7 +220,7 @@ int main(int argc, char **argv) {
     uint64_t *seq_addresses = nullptr, *random_addresses = nullptr;
     uint32_t to_hammer_lba = 10000;
 
-    struct zdev_init_params params;
+    struct zdev_init_params params{};
     params.force_reset = true;
     params.log_zones = 3;
     params.gc_wmark = 1;
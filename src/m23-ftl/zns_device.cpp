@@ -33,27 +33,205 @@ SOFTWARE.
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <endian.h>
+#include <sched.h>
+#include <time.h>
+#ifdef STOSYS_ZLIB
+#include <zlib.h>
+#endif
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
 #include <unordered_map>
+#include <deque>
+#include <vector>
+#include <string>
 #include <iostream>
+#include <algorithm>
 
 #include "zns_device.h"
+#include "io_sched.h"
+#include "executor.h"
+#include "zns_volume.h"
 #include "../common/unused.h"
+#include "../common/zone_report.h"
+#include "../common/utils.h"
 
 extern "C" {
 
-    std::unordered_map<int64_t, int64_t> log_zone_mapping;
-    std::unordered_map<int64_t, int64_t> data_zone_mapping;
+    // blocks of a logical zone trimmed or written as all zeroes, and not written with data since. They read
+    // back as zeroes and merges do not copy them. A block written with data again leaves the set
+    struct trim_set {
+        std::vector<bool> blocks;
+        uint32_t count;
+    };
+
+    // log blocks stored compressed (compress): packed back to back, a block starts offset bytes into the LBA
+    // its log mapping points at and takes len bytes, maybe on into the next LBA. len == LBA size is a block
+    // that did not compress and is packed as it is
+    struct packed_block {
+        uint32_t offset;
+        uint32_t len;
+    };
+
+    // deduplication (dedup): log blocks by their place on the device (byte address, so packed blocks have one of
+    // their own), with the fingerprint of their content and the log mappings that point at them. The index takes
+    // a fingerprint to one such block, a block is only shared after its content was compared
+    struct dedup_ref {
+        uint64_t fp;
+        uint32_t refs;
+        // packed length, 0 if not packed
+        uint32_t len;
+    };
+
+    // a log block a write may share, as the write saw it before the gc_mutex: its reference and the resets of
+    // its zone, a reset since means the block may have been written again
+    struct dedup_seen {
+        struct dedup_ref ref;
+        uint32_t resets;
+    };
+
+    // the log is appended as separate streams, each with its own open zone (-1 when it has none yet).
+    // Without hot/cold separation everything goes to the cold stream. Writes with a lifetime hint go to
+    // the stream of their hint. Blocks GC moves along inside the log get streams of their own, one per
+    // number of GC passes they survived (up to GC_AGE_MAX)
+    const int GC_AGE_MAX = 3;
+    enum {
+        LOG_STREAM_COLD = 0,
+        LOG_STREAM_HOT,
+        LOG_STREAM_HINT,
+        LOG_STREAM_GC = LOG_STREAM_HINT + ZNS_N_HINTS - 1,
+        N_LOG_STREAMS = LOG_STREAM_GC + GC_AGE_MAX
+    };
+
+    // write counter of one LBA range, decayed lazily: it halves for every epoch passed since it was last touched
+    struct heat_counter {
+        uint16_t hits;
+        uint16_t epoch;
+    };
+
+    // a sequential write stream caught at the start of a logical zone. While it is short it still goes
+    // to the log (zone == -1), once it is long enough it gets a zone of its own that becomes the data zone
+    struct seq_run {
+        int64_t lzone;
+        uint32_t len;
+        int64_t zone;
+    };
+    const size_t SEQ_RUN_SLOTS = 2;
+
+    // no foreground command for this long (us) counts as idle
+    const uint64_t GC_IDLE_US = 2000;
+    // the ingest rate takes in the log writes of this long (us) at a time
+    const uint64_t INGEST_WINDOW_US = 10000;
+    // the peak ingest rate halves every this long (us) once the writes slow down
+    const uint64_t INGEST_PEAK_HALF_US = 1000000;
+    // background GC share of gc_adaptive when gc_bw_pct is 0
+    const uint32_t GC_ADAPTIVE_BW_PCT = 10;
+
+    // what the FTL knows about the data on a device. It outlasts a deinit: the next instance on the device
+    // takes it over, unless it resets the device. The FTL keeps no metadata on the device itself
+    struct zns_ftl_maps {
+        std::unordered_map<int64_t, int64_t> log_zone_mapping;
+        std::unordered_map<int64_t, int64_t> data_zone_mapping;
+        std::unordered_map<int64_t, struct trim_set> trimmed_zones;
+        std::unordered_map<int64_t, struct packed_block> packed_blocks;
+        std::unordered_map<int64_t, struct dedup_ref> dedup_refs;
+        std::unordered_map<uint64_t, int64_t> dedup_index;
+        // CRC32C of every user block as the user wrote it (checksum), by logical block. Trimmed and never
+        // written blocks have the checksum of a block of zeroes
+        std::vector<uint32_t> block_crcs;
+        // resets per zone over the life of the device, these outlast a force_reset too
+        std::vector<uint32_t> zone_resets;
+        // chunks of data zones rewritten on their own (chunk_blocks), by logical chunk: the LBA of the copy in
+        // the chunk area that replaces that part of the data zone. chunk_map_blocks is the chunk size they are in
+        std::unordered_map<int64_t, int64_t> chunk_mapping;
+        uint32_t chunk_map_blocks;
+    };
+
+    // one device driven by the FTL, _private points at its metadata. Devices share only the background
+    // executor, each has its own maps, zone pools, GC and reset state, and scheduler
+    struct zns_ftl : zns_device_metadata, zns_ftl_maps {
+        struct user_zns_device *dev;
+        std::string name;
+        // one deflate stream for all blocks, set up once: setting it up per block costs more than the compression.
+        // The log is only written under the gc_mutex
+#ifdef STOSYS_ZLIB
+        z_stream block_deflater;
+#endif
+        uint32_t zero_block_crc;
+
+        // pre-erased zones ready to be handed out, and used zones waiting for the background reset
+        std::deque<uint32_t> free_zones;
+        std::deque<uint32_t> reset_queue;
+        // zones holding the log, in the order they were opened. The last one takes the appends
+        std::vector<uint32_t> log_zone_list;
+        int64_t log_stream_zone[N_LOG_STREAMS];
+        std::vector<struct heat_counter> heat_map;
+        std::vector<struct seq_run> seq_runs;
+
+        // logical zones the open GC pass still has to merge, the victim zone of the pass, and the blocks it moved within the log so far
+        std::deque<int64_t> gc_pending;
+        int64_t gc_victim;
+        uint32_t gc_pass_relocated;
+        // a writer woken by GC has not taken the gc_mutex yet, no background pass takes the space it was woken for
+        bool gc_writer_woken;
+        // free log zones (with the zone a merge holds) and zones GC had reclaimed when a write was last turned
+        // away with -EAGAIN, to tell whether GC got anywhere since
+        int64_t backoff_free;
+        uint64_t backoff_reclaimed;
+        // blocks going into the log per us lately, and the log blocks written and the time when it was last taken in
+        double ingest_rate;
+        // the highest rate lately, it fades slowly, so a quiet spell between bursts does not hide the next burst
+        double ingest_peak;
+        uint64_t ingest_blocks;
+        uint64_t ingest_at_us;
+        // GC I/O of the merge under way, counted here while the gc_mutex is not held and added to the stats when it commits
+        struct zns_udevice_stats merge_io;
+        // the zone a merge is copying into holds its place in the log budget until the old data zone is given back
+        int64_t merge_zones;
+        // zones of the chunk area, the one chunks are appended to (-1 when none is open) and where the next one goes.
+        // Only GC writes there, a slot is taken when a merge is planned and written when it copies
+        std::vector<uint32_t> chunk_zone_list;
+        int64_t chunk_zone;
+        uint64_t chunk_next;
+    };
 
-    struct user_zns_device *zns_device;
-    struct zns_device_metadata *zns_metadata;
+    // the maps of devices no instance has open, by device name (and shard, see ftl_init)
+    static std::unordered_map<std::string, struct zns_ftl_maps> kept_maps;
+    static pthread_mutex_t kept_maps_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    // GC and zone resets of every instance run as tasks here. The first instance makes it, the last one frees it
+    static struct ss_executor *bg_executor = nullptr;
+    static uint32_t bg_executor_users = 0;
+    static pthread_mutex_t bg_executor_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    static struct zns_ftl *ftl_of(struct user_zns_device *my_dev) {
+        return static_cast<struct zns_ftl *>((struct zns_device_metadata *)my_dev->_private);
+    }
 
     const int EMPTY_ZONE = 1;
+    const int IMP_OPEN_ZONE = 2;
+    const int CLOSED_ZONE = 4;
+    const int READ_ONLY_ZONE = 13;
     const int FULL_ZONE = 14;
+    const int OFFLINE_ZONE = 15;
 
     // Temporary value. MDTS check risks intermittent segmentation fault. 
     // Uncomment mmap_registers(), get_mdts_size() functions if memory leak root cause has been addressed.
     const int MDTS = (64 * 4096);
 
+    // ONCS bit for the Copy command, libnvme has no name for it
+    const int ONCS_COPY = 1 << 8;
+
+    // threads of the I/O scheduler when it queues (io_sched != 0)
+    const uint32_t IO_SCHED_WORKERS = 2;
+    // threads of the background executor when bg_threads is 0
+    const uint32_t BG_THREADS = 2;
+
     /*
     The functions mmap_registers() and get_mdts_size() are intended to extract MDTS value of ZNS device.
     Comment them out if hardcoding a constant yields better performance, and if test environment will remain the same.
@@ -147,10 +325,10 @@ extern "C" {
     */
 
     // Read/Write operations involving data buffer larger than MDTS size
-    int io_with_mdts(int fd, uint32_t nsid, uint64_t slba, void *buffer, uint64_t buf_size, bool read) { 
+    int io_with_mdts(struct zns_ftl *metadata, int io_class, uint64_t slba, void *buffer, uint64_t buf_size, bool read) { 
         int ret = -ENOSYS;
 
-        uint64_t size_to_io, buf_ptr, single_io_size, write_pointer, lba_num, /* mdts_size = zns_metadata->mdts,*/ lba_size = zns_device->lba_size_bytes;
+        uint64_t size_to_io, buf_ptr, single_io_size, write_pointer, lba_num, /* mdts_size = metadata->mdts,*/ lba_size = metadata->dev->lba_size_bytes;
         size_to_io = buf_size;
         buf_ptr = 0;
         write_pointer = slba; 
@@ -168,12 +346,12 @@ extern "C" {
             
             // Perform IO
             if (read) {
-                ret = nvme_read(fd, nsid, write_pointer, lba_num, 0, 0, 0, 0, 0, single_io_size, new_buf, 0, NULL);
+                ret = ss_io_read(metadata->io_sched, io_class, write_pointer, lba_num + 1, new_buf);
                 // printf("[DEBUG] READ WITH MDTS: %d\n", ret);
                 // printf("nsid: %d, write_pointer: %lu, num_blocks: %lu\n", nsid, write_pointer, single_io_size / lba_size);
             } else {
                 // TODO: Switch nvme_write() to nvme_zns_append() method.
-                ret = nvme_write(fd, nsid, write_pointer, lba_num, 0, 0, 0, 0, 0, 0, single_io_size, new_buf, 0, NULL);
+                ret = ss_io_write(metadata->io_sched, io_class, write_pointer, lba_num + 1, new_buf);
                 //ret = nvme_zns_append(fd, nsid, write_pointer, single_io_size / lba_size - 1,
                 //0, 0, 0, 0, single_io_size, (char*) buffer, 0, nullptr, lba_result);
                 // printf("[DEBUG] WRITE WITH MDTS: %d\n", ret);
@@ -193,375 +371,2999 @@ extern "C" {
     }
     
 
-    uint32_t free_zone_number(int offset) {
-        return zns_metadata->log_zone_num_config - (zns_metadata->log_zone_end - zns_metadata->log_zone_start + offset) / zns_metadata->n_blocks_per_zone;
+    /**
+    * Zone mirror
+    * Every zone state change made by the FTL goes through the helpers below, so the
+    * mirror in metadata->zones stays authoritative and the hot path never needs a zone report.
+    * The device is only asked again on demand (an I/O error) or for the consistency check.
+    */
+    static void zone_mirror_fill(struct zns_zone_info *zone, struct nvme_zns_desc *desc) {
+        zone->slba = le64_to_cpu(desc->zslba);
+        zone->wp = le64_to_cpu(desc->wp);
+        zone->cap = le64_to_cpu(desc->zcap);
+        zone->state = desc->zs >> 4;
     }
 
-    // find the next empty zone address
-    int next_empty_zone() {
-        for (uint64_t i = zns_metadata->log_zone_num_config; i < zns_device->tparams.zns_num_zones; i++) {
-            if (zns_metadata->zone_states[i] == EMPTY_ZONE) {
-                return i * zns_metadata->n_blocks_per_zone;
-            }
+    // Load the whole mirror, streaming the zone report in fixed-size chunks
+    int zone_mirror_load(struct zns_ftl *metadata) {
+        struct ss_zone_report_iter iter{};
+        struct nvme_zns_desc *desc = nullptr;
+        uint32_t i = 0;
+        int ret = ss_zone_report_iter_init(&iter, metadata->fd, metadata->nsid, SS_ZONE_REPORT_CHUNK);
+        while (ret == 0 && (ret = ss_zone_report_iter_next(&iter, &desc)) == 0 && desc != nullptr && i < metadata->n_zones) {
+            zone_mirror_fill(&metadata->zones[i++], desc);
+        }
+        ss_zone_report_iter_free(&iter);
+        if (ret != 0) {
+            printf("[ERROR] FAILED TO REPORT ALL ZONE INFO: %d\n", ret);
         }
-        return -1;
+        return ret;
     }
 
-    // Full merge operation
-    int zone_merge(std::unordered_map<int64_t, std::unordered_map<int64_t, int64_t>*> *zone_sets_ptr) {
-        auto zone_set = *zone_sets_ptr;
-
-        int64_t ret = -ENOSYS;
-        int64_t num_blocks = zns_metadata->n_blocks_per_zone, lsb = zns_device->lba_size_bytes;
-        char buffer[num_blocks * lsb] = {0};   
+    // a zone management command, run by the I/O scheduler as a metadata command
+    struct zone_mgmt_cmd {
+        struct zns_ftl *metadata;
+        uint64_t slba;
+        enum nvme_zns_send_action zsa;
+        // report: receive buffer
+        void *buf;
+        uint32_t len;
+    };
 
-        auto iteration = zone_set.begin();
-        for (iteration; iteration != zone_set.end(); iteration++) {
-            UNUSED(iteration);
-            int64_t zone_number = next_empty_zone(), prev_zone = -1;
-            bool used_log = false;
-            if (zone_number == -1) {
-                zone_number = (zns_metadata->log_zone_num_config - 1) * zns_metadata->n_blocks_per_zone; // use the last zone of log zones
-                used_log = true;
-            }
+    static int zone_mgmt_send_cmd(void *arg) {
+        auto *cmd = (struct zone_mgmt_cmd *)arg;
+        return nvme_zns_mgmt_send(cmd->metadata->fd, cmd->metadata->nsid, cmd->slba, false, cmd->zsa, 0, NULL);
+    }
 
-            if (data_zone_mapping.find(iteration->first) != data_zone_mapping.end()) {
-                ret = io_with_mdts(zns_metadata->fd, zns_metadata->nsid, data_zone_mapping[iteration->first], buffer, num_blocks * lsb, true);
-                if (ret) {
-                    printf("ERROR: failed during merging");
-                    return ret;
-                }
-                
-                zns_metadata->zone_states[data_zone_mapping[iteration->first] / num_blocks] = EMPTY_ZONE;
-                prev_zone = data_zone_mapping[iteration->first];
-            }
-            
-            auto map = *(iteration->second);
-            auto j = map.begin();
-            for (j; j != map.end(); j++) {
-                UNUSED(j);
-                ret = nvme_read(zns_metadata->fd, zns_metadata->nsid, j->second, 0, 0, 0, 0, 0, 0, lsb, buffer + lsb * j->first, 0, NULL);
-                if (ret) {
-                    printf("ERROR: failed to read log block at 0x%lx, ret: %ld\n", j->second, ret);
-                    return ret;
-                }
-            }
+    static int zone_report_cmd(void *arg) {
+        auto *cmd = (struct zone_mgmt_cmd *)arg;
+        return nvme_zns_mgmt_recv(cmd->metadata->fd, cmd->metadata->nsid, cmd->slba, NVME_ZNS_ZRA_REPORT_ZONES, NVME_ZNS_ZRAS_REPORT_ALL, true, cmd->len, cmd->buf);
+    }
 
-            if (used_log) {
-                nvme_zns_mgmt_send(zns_metadata->fd, zns_metadata->nsid, prev_zone, false, NVME_ZNS_ZSA_RESET, 0, NULL);
-                ret = io_with_mdts(zns_metadata->fd, zns_metadata->nsid, prev_zone, buffer, num_blocks * lsb, false);
-                if (ret) {
-                    printf("ERROR: failed to write zone at 0x%lx, ret: %ld, used log zone\n", zone_number, ret);
-                    return ret;
-                }
-                zns_metadata->zone_states[prev_zone / num_blocks] = FULL_ZONE;
-                nvme_zns_mgmt_send(zns_metadata->fd, zns_metadata->nsid, zone_number, false, NVME_ZNS_ZSA_RESET, 0, NULL);
-            } else {
-                ret = io_with_mdts(zns_metadata->fd, zns_metadata->nsid, zone_number, buffer, num_blocks * lsb, false);
-                if (ret) {
-                    printf("ERROR: failed to write zone at 0x%lx, ret: %ld\n", zone_number, ret);
-                    return ret;
-                }
-                data_zone_mapping[iteration->first] = zone_number;
-                zns_metadata->zone_states[zone_number / num_blocks] = FULL_ZONE;
+    static int changed_zones_cmd(void *arg) {
+        auto *cmd = (struct zone_mgmt_cmd *)arg;
+        return nvme_get_log(cmd->metadata->fd, NVME_LOG_LID_ZNS_CHANGED_ZONES, cmd->metadata->nsid, 0, NVME_LOG_LSP_NONE, NVME_LOG_LSI_NONE, false, NVME_UUID_NONE, NVME_CSI_ZNS, cmd->len, cmd->buf);
+    }
 
-                if (prev_zone != -1)
-                    nvme_zns_mgmt_send(zns_metadata->fd, zns_metadata->nsid, prev_zone, false, NVME_ZNS_ZSA_RESET, 0, NULL);
-            }
-            delete iteration->second;
+    // Re-read a single zone descriptor from the device
+    int zone_mirror_refresh(struct zns_ftl *metadata, uint32_t zone_no) {
+        char buf[sizeof(struct nvme_zone_report) + sizeof(struct nvme_zns_desc)] = {0};
+        auto *report = (struct nvme_zone_report *)buf;
+        struct zone_mgmt_cmd cmd = {metadata, metadata->zones[zone_no].slba, NVME_ZNS_ZSA_RESET, report, sizeof(buf)};
+        int ret = ss_io_cmd(metadata->io_sched, SS_IO_META, zone_report_cmd, &cmd);
+        if (ret != 0) {
+            printf("[ERROR] FAILED TO REPORT ZONE %u: %d\n", zone_no, ret);
+            return ret;
         }
+        zone_mirror_fill(&metadata->zones[zone_no], &report->entries[0]);
         return 0;
     }
 
-    // trigger_gc() only takes args argument, can't take zns_device_metadata as a parameter
-    // Other arguments beside args break pthread, since pthread's values and parameters have to be constant throughout the program
-    void *trigger_gc(void *args) {
-        struct zns_device_metadata *metadata = (struct zns_device_metadata *)args;
-        while (true) {
-            pthread_mutex_lock(&metadata->gc_mutex);
-            while (!metadata->gc_thread_stop && !metadata->trigger_my_gc) {
-                // signal
-                pthread_cond_wait(&metadata->start_gc, &metadata->gc_mutex);
-            }
-
-            if (metadata->gc_thread_stop) {
-                pthread_mutex_unlock(&metadata->gc_mutex);
-                break;
-            }
-
-            std::unordered_map<int64_t, std::unordered_map<int64_t, int64_t>*> zone_sets;
-            std::unordered_map<int64_t, int64_t>::iterator iteration;
-            for (iteration = log_zone_mapping.begin(); iteration != log_zone_mapping.end(); iteration++) {
-                int64_t zone_number = ((iteration->first) / (zns_metadata->n_blocks_per_zone * zns_device->lba_size_bytes)) + zns_metadata->log_zone_num_config;
-                if (!(zone_sets.find(zone_number) != zone_sets.end())) {
-                    zone_sets[zone_number] = new std::unordered_map<int64_t, int64_t>;
-                }
-                auto map = zone_sets[zone_number];
-                map->insert(std::pair<int64_t, int64_t>(((iteration->first) % (zns_metadata->n_blocks_per_zone * zns_device->lba_size_bytes) / zns_device->lba_size_bytes), iteration->second));
-                // Invalidates the second pair of std::iterator iteration
-                iteration->second &= (1L << 63);
-            }
-            int ret = zone_merge(&zone_sets);
-            
-            if (ret) {
-                printf("Error: GC failed, ret:%d\n", ret);
-            }
+    // Pull in the zones the device changed behind our back (ZNS Changed Zone List log page)
+    int zone_mirror_reconcile(struct zns_ftl *metadata) {
+        struct nvme_zns_changed_zone_log log{};
+        struct zone_mgmt_cmd cmd = {metadata, 0, NVME_ZNS_ZSA_RESET, &log, sizeof(log)};
+        int ret = ss_io_cmd(metadata->io_sched, SS_IO_META, changed_zones_cmd, &cmd);
+        if (ret != 0) {
+            printf("[ERROR] FAILED TO GET CHANGED ZONE LIST: %d\n", ret);
+            return ret;
+        }
 
-            for (int i = 0; i < metadata->log_zone_num_config; i++) {
-                nvme_zns_mgmt_send(metadata->fd, metadata->nsid, i * metadata->n_blocks_per_zone, false, NVME_ZNS_ZSA_RESET, 0, NULL);
+        uint16_t nrzid = le16_to_cpu(log.nrzid);
+        // 0xffff means the list overflowed, only a full report can tell what changed
+        if (nrzid == 0xffff) {
+            return zone_mirror_load(metadata);
+        }
+        for (uint16_t i = 0; i < nrzid && i < NVME_ZNS_CHANGED_ZONES_MAX; i++) {
+            ret = zone_mirror_refresh(metadata, le64_to_cpu(log.zid[i]) / metadata->n_blocks_per_zone);
+            if (ret != 0) {
+                return ret;
             }
-
-            metadata->log_zone_end = metadata->log_zone_start;
-            log_zone_mapping.clear();
-            metadata->trigger_my_gc = false;
-            pthread_cond_signal(&metadata->stop_gc);
-            pthread_mutex_unlock(&metadata->gc_mutex);
         }
-        return (void *)0;
+        return 0;
     }
-        
-    int deinit_ss_zns_device(struct user_zns_device *my_dev) {
-        int ret = -ENOSYS;
-
-        //struct zns_device_metadata *metadata = (struct zns_device_metadata *)my_dev->_private;
-        auto *metadata = (struct zns_device_metadata *)my_dev->_private;
-        metadata->gc_thread_stop = true;
-        pthread_cond_signal(&metadata->start_gc);
 
-        // wait for gc stop
-        pthread_join(metadata->gc_thread_id, NULL);
+    // Account nlb blocks written starting at slba
+    void zone_mirror_append(struct zns_ftl *metadata, uint64_t slba, uint64_t nlb) {
+        struct zns_zone_info *zone = &metadata->zones[slba / metadata->n_blocks_per_zone];
+        zone->wp = slba + nlb;
+        zone->state = (zone->wp >= zone->slba + zone->cap) ? FULL_ZONE : IMP_OPEN_ZONE;
+    }
 
-        pthread_mutex_destroy(&metadata->gc_mutex);
-        pthread_cond_destroy(&metadata->start_gc);
-        ret = close(metadata->fd);
-        
+    int zone_reset(struct zns_ftl *metadata, uint64_t slba) {
+        struct zone_mgmt_cmd cmd = {metadata, slba, NVME_ZNS_ZSA_RESET, nullptr, 0};
+        int ret = ss_io_cmd(metadata->io_sched, SS_IO_META, zone_mgmt_send_cmd, &cmd);
         if (ret != 0) {
-            printf("[ERROR] FAILED TO CLOSE FILE DESC: %d\n", ret);
+            printf("[ERROR] FAILED TO RESET ZONE AT 0x%lx: %d\n", slba, ret);
+            zone_mirror_refresh(metadata, slba / metadata->n_blocks_per_zone);
             return ret;
         }
-
-        free(metadata->zone_states);
-        free(my_dev->_private);
-        free(my_dev);
-        
-        return ret;
+        struct zns_zone_info *zone = &metadata->zones[slba / metadata->n_blocks_per_zone];
+        zone->wp = zone->slba;
+        zone->state = EMPTY_ZONE;
+        __atomic_add_fetch(&metadata->zone_resets[slba / metadata->n_blocks_per_zone], 1, __ATOMIC_RELAXED);
+        return 0;
     }
 
-    int init_ss_zns_device(struct zdev_init_params *params, struct user_zns_device **my_dev) {
-        int ret = -ENOSYS;
-
-        int fd = nvme_open(params->name);
-        if (fd < 0) {
-            printf("[ERROR] FAILED TO OPEN FILE DESC: %d\n", fd);
-            return ret;
-        }
-
-        auto *metadata = static_cast<struct zns_device_metadata *>(calloc(sizeof(struct zns_device_metadata), 1));
-        (*my_dev) = static_cast<struct user_zns_device *>(calloc(sizeof(struct user_zns_device), 1));
-        
-        metadata->fd = fd;
-        metadata->gc_watermark = params->gc_wmark;
-        metadata->log_zone_num_config = params->log_zones;
-        (*my_dev)->_private = metadata;
-        
-        /**
-        * Device Identification Phase
-        * Mainly for collecting related attributes of the zns device
-        */
-
-        // Get namespace id
-        ret = nvme_get_nsid(fd, &metadata->nsid);
+    int zone_finish(struct zns_ftl *metadata, uint64_t slba) {
+        struct zone_mgmt_cmd cmd = {metadata, slba, NVME_ZNS_ZSA_FINISH, nullptr, 0};
+        int ret = ss_io_cmd(metadata->io_sched, SS_IO_META, zone_mgmt_send_cmd, &cmd);
         if (ret != 0) {
-            printf("[ERROR] FAILED TO GET NAMESPACE ID: %d\n", ret);
+            printf("[ERROR] FAILED TO FINISH ZONE AT 0x%lx: %d\n", slba, ret);
+            zone_mirror_refresh(metadata, slba / metadata->n_blocks_per_zone);
             return ret;
         }
+        struct zns_zone_info *zone = &metadata->zones[slba / metadata->n_blocks_per_zone];
+        zone->wp = zone->slba + zone->cap;
+        zone->state = FULL_ZONE;
+        return 0;
+    }
 
-        // Get namespace metadata
-        struct nvme_id_ns ns{};
-        ret = nvme_identify_ns(fd, metadata->nsid, &ns);
+    // Consistency check mode: compare the mirror with a fresh full report, returns the number of mismatches
+    int zone_mirror_check(struct zns_ftl *metadata) {
+        struct ss_zone_report_iter iter{};
+        struct nvme_zns_desc *desc = nullptr;
+        int mismatches = 0;
+        int ret = ss_zone_report_iter_init(&iter, metadata->fd, metadata->nsid, SS_ZONE_REPORT_CHUNK);
+        for (uint32_t i = 0; ret == 0 && (ret = ss_zone_report_iter_next(&iter, &desc)) == 0 && desc != nullptr && i < metadata->n_zones; i++) {
+            struct zns_zone_info device{};
+            zone_mirror_fill(&device, desc);
+            // the zones of other shards are not kept up to date here
+            if (i < metadata->shard_zone_start || i >= metadata->shard_zone_end) {
+                continue;
+            }
+            struct zns_zone_info *zone = &metadata->zones[i];
+            // the device may close an open zone on its own, that is not a mismatch
+            bool same_state = (zone->state == device.state) || (zone->state == IMP_OPEN_ZONE && device.state == CLOSED_ZONE);
+            if (zone->wp != device.wp || zone->cap != device.cap || !same_state) {
+                printf("[ERROR] ZONE MIRROR MISMATCH zone %u: wp 0x%lx/0x%lx cap 0x%lx/0x%lx state %u/%u (mirror/device)\n",
+                       i, zone->wp, device.wp, zone->cap, device.cap, zone->state, device.state);
+                mismatches++;
+            }
+        }
+        ss_zone_report_iter_free(&iter);
         if (ret != 0) {
-            printf("[ERROR] FAILED TO GET NAMESPACE METADATA: %d\n", ret);
+            printf("[ERROR] FAILED TO REPORT ALL ZONE INFO: %d\n", ret);
             return ret;
         }
+        return mismatches;
+    }
 
-        // Get zone report (for a single one)
-        struct nvme_zone_report single_zone_report{};
-        ret = nvme_zns_mgmt_recv(fd, metadata->nsid, 0, NVME_ZNS_ZRA_REPORT_ZONES, NVME_ZNS_ZRAS_REPORT_ALL, false, sizeof(single_zone_report), (void *)&single_zone_report);
-        if (ret != 0) {
-            printf("[ERROR] FAILED TO REPORT ZONE INFO: %d\n", ret);
-            return ret;
+    // count one more write to the range holding block lba, true if the range counts as hot
+    bool heat_touch(struct zns_ftl *metadata, uint64_t lba) {
+        struct heat_counter *counter = &metadata->heat_map[lba / metadata->heat_range_blocks];
+        uint16_t age = metadata->heat_epoch - counter->epoch;
+        counter->hits = age >= 16 ? 0 : counter->hits >> age;
+        counter->epoch = metadata->heat_epoch;
+        if (counter->hits < UINT16_MAX) {
+            counter->hits++;
         }
+        return counter->hits >= 2;
+    }
 
-        (*my_dev)->tparams.zns_num_zones = single_zone_report.nr_zones;
-        metadata->zone_states = (uint8_t *)calloc(single_zone_report.nr_zones, sizeof(uint8_t));
+    void heat_advance(struct zns_ftl *metadata, uint32_t blocks) {
+        metadata->heat_writes += blocks;
+        while (metadata->heat_writes >= metadata->heat_epoch_blocks) {
+            metadata->heat_writes -= metadata->heat_epoch_blocks;
+            metadata->heat_epoch++;
+        }
+    }
 
-        if (params->force_reset)
-        {
-            ret = nvme_zns_mgmt_send(fd, metadata->nsid, 0, true, NVME_ZNS_ZSA_RESET, 0, NULL);
-            if (ret)
-            {
-                printf("ERROR: failed to reset all zones %d \n", ret);
-                return ret;
-            }
+    // a run of blocks of one write request that goes to the same log stream
+    struct stream_run {
+        uint32_t start, blocks;
+        int stream;
+    };
 
-            // metadata->data_zone_start = metadata->data_zone_end = params->log_zones * n_blocks_per_zone;
-            metadata->log_zone_start = metadata->log_zone_end = 0;
+    // zones held by sequential runs, they are taken from the log budget until they are installed
+    int64_t seq_run_zones(struct zns_ftl *metadata) {
+        int64_t n = 0;
+        for (auto &run : metadata->seq_runs) {
+            n += (run.zone != -1);
         }
+        return n;
+    }
 
-        //metadata->mdts = get_mdts_size(metadata->fd);
-        metadata->mdts = MDTS;
+    // log zones left under the log budget
+    int64_t log_zones_free(struct zns_ftl *metadata) {
+        return (int64_t)metadata->log_zone_num_config - (int64_t)metadata->log_zone_list.size() - seq_run_zones(metadata) - metadata->merge_zones;
+    }
 
-        // Get zone report (for all zones)
-        // After getting the one single_zone_report, we now know the number of zones
-        // Then we proceed to getting reports of all zones
-        uint64_t all_zone_reports_size = sizeof(single_zone_report) + (single_zone_report.nr_zones * sizeof(struct nvme_zns_desc));
-        char *all_zone_reports= (char *)calloc(1, all_zone_reports_size);
-        ret = nvme_zns_mgmt_recv(fd, metadata->nsid, 0, NVME_ZNS_ZRA_REPORT_ZONES, NVME_ZNS_ZRAS_REPORT_ALL, 1, all_zone_reports_size, (void *)all_zone_reports);
-        // For the time being the reported zone numbers should be 32,
-        // so ((struct nvme_zone_report *)all_zone_reports)->entries[31] should be the last zone
-        if (ret != 0) {
-            printf("[ERROR] FAILED TO REPORT ALL ZONE INFO: %d\n", ret);
-            free(all_zone_reports);
-            return ret;
+    // log zones still free under the log budget if the runs were appended now
+    int64_t free_zone_number(struct zns_ftl *metadata, std::vector<struct stream_run> &runs) {
+        uint64_t pending[N_LOG_STREAMS] = {0};
+        for (auto &run : runs) {
+            pending[run.stream] += run.blocks;
         }
+        int64_t needed = 0;
+        for (int s = 0; s < N_LOG_STREAMS; s++) {
+            uint64_t room = 0;
+            if (metadata->log_stream_zone[s] != -1) {
+                struct zns_zone_info *zone = &metadata->zones[metadata->log_stream_zone[s]];
+                room = zone->slba + zone->cap - zone->wp;
+            }
+            if (pending[s] > room) {
+                needed += (pending[s] - room + metadata->n_blocks_per_zone - 1) / metadata->n_blocks_per_zone;
+            }
+        }
+        return log_zones_free(metadata) - needed;
+    }
 
-        /**
-        * Attributes & Data Population Phase
-        * Mainly for calculating and filling in corresponding attributes data
-        * to the metadata and related struct
-        */
-        (*my_dev)->lba_size_bytes = 1 << ns.lbaf[(ns.flbas & 0xf)].ds;
-        (*my_dev)->tparams.zns_lba_size = (*my_dev)->lba_size_bytes;
-        // (*my_dev)->tparams.zns_num_zones = single_zone_report.nr_zones;
-        uint64_t n_blocks_per_zone = ((struct nvme_zone_report *)all_zone_reports)->entries[0].zcap;
-        //metadata->n_blocks_per_zone = n_blocks_per_zone;
-        (*my_dev)->tparams.zns_zone_capacity = n_blocks_per_zone * (*my_dev)->lba_size_bytes;
-        (*my_dev)->capacity_bytes = (single_zone_report.nr_zones - params->log_zones) * ((*my_dev)->tparams.zns_zone_capacity);
-
-        // For Milestone 2, GC watermark and two "pointers" chasing each other
-        // metadata->gc_watermark = params->gc_wmark;
-        metadata->log_zone_start = 0;
-        metadata->log_zone_end = 0;
-        metadata->data_zone_start = params->log_zones * n_blocks_per_zone;
-        metadata->data_zone_end = params->log_zones * n_blocks_per_zone;
-        metadata->n_blocks_per_zone = n_blocks_per_zone;
-        metadata->n_log_zone = params->log_zones;
+    /**
+    * GC rate control
+    * With gc_bw_pct set, GC starts ahead of the watermark, once the free log zones come within gc_slack of it.
+    * It is paced by a token bucket: every foreground block earns GC blocks so that GC takes about gc_bw_pct
+    * of the device I/O. The closer the log gets to the watermark, the larger that share (all of it at the
+    * watermark, where writers block and GC runs flat out anyway). An idle device gets GC without tokens.
+    * With gc_adaptive the slack follows the rate the log fills at: GC starts while the zones left above the
+    * watermark still last as long as GC takes to give back a couple of zones at the peak rate of late. An
+    * idle device is cleaned further ahead, up to twice the slack, so the next burst finds room.
+    */
+    // blocks that went into the log: user writes to the log, sequential runs, blocks GC moved along
+    static uint64_t log_blocks_written(struct zns_ftl *metadata) {
+        return metadata->stats.log_write_blocks + metadata->stats.direct_write_blocks + metadata->stats.gc_relocated_blocks;
+    }
 
-        for (uint64_t i = params->log_zones; i < single_zone_report.nr_zones; i++) {
-            metadata->zone_states[i] = (((struct nvme_zone_report *)all_zone_reports)->entries[i].zs >> 4);
+    // take the log writes since the last time into the ingest rate, once a window has passed. Every window
+    // weighs a quarter, windows without writes too, so the rate falls off once the writes stop
+    void ingest_sample(struct zns_ftl *metadata) {
+        uint64_t now = microseconds_since_epoch();
+        uint64_t elapsed = now - metadata->ingest_at_us;
+        if (elapsed < INGEST_WINDOW_US) {
+            return;
         }
+        uint64_t blocks = log_blocks_written(metadata);
+        double keep = pow(0.75, (double)elapsed / INGEST_WINDOW_US);
+        metadata->ingest_rate = keep * metadata->ingest_rate + (1 - keep) * (double)(blocks - metadata->ingest_blocks) / elapsed;
+        metadata->ingest_peak = std::max(metadata->ingest_rate, metadata->ingest_peak * pow(0.5, (double)elapsed / INGEST_PEAK_HALF_US));
+        metadata->ingest_blocks = blocks;
+        metadata->ingest_at_us = now;
+    }
 
-        free(all_zone_reports);
+    // free log zones above the watermark at which background GC starts
+    uint32_t gc_slack_zones(struct zns_ftl *metadata) {
+        uint64_t reclaimed = metadata->stats.gc_zones_reclaimed;
+        if (!metadata->gc_adaptive || reclaimed == 0) {
+            return metadata->gc_slack;
+        }
+        // the zones a burst of writes takes while GC gives back two, at what a zone cost GC so far, and one to spare
+        double zone_us = (double)metadata->stats.gc_time_us / reclaimed;
+        double zones = metadata->ingest_peak * 2 * zone_us / metadata->n_blocks_per_zone;
+        uint32_t most = std::max<int64_t>(1, (int64_t)metadata->log_zone_num_config - metadata->gc_watermark - 1);
+        return std::min<double>(most, std::ceil(zones) + 1);
+    }
 
-        ret = pthread_create(&metadata->gc_thread_id, NULL, &trigger_gc, metadata);
-        if (ret) {
-            printf("ERROR: failed to create gc thread %d \n", ret);
-            return ret;
+    double gc_urgency(struct zns_ftl *metadata) {
+        int64_t room = log_zones_free(metadata) - (int64_t)metadata->gc_watermark;
+        uint32_t slack = gc_slack_zones(metadata);
+        if (room > (int64_t)slack) {
+            return 0;
         }
+        return room <= 0 ? 1 : 1 - (double)room / (slack + 1);
+    }
 
-        zns_device = *my_dev;
-        zns_metadata = metadata;
+    void gc_task(void *args);
 
-        // Reset the device if required
-        if (params->force_reset) {
-            ret = nvme_zns_mgmt_send(fd, metadata->nsid, 0, true, NVME_ZNS_ZSA_RESET, 0, NULL);
-            if (ret != 0) {
-                printf("[ERROR] FAILED TO RESET ALL ZONES: %d\n", ret);
-                return ret;
+    // have a GC task look at the state, the caller holds the gc_mutex
+    void gc_kick(struct zns_ftl *metadata) {
+        if (metadata->gc_stop || metadata->gc_scheduled) {
+            return;
+        }
+        metadata->gc_scheduled = true;
+        ss_executor_submit(bg_executor, gc_task, metadata);
+    }
+
+    bool gc_background_due(struct zns_ftl *metadata) {
+        if (metadata->gc_bw_pct == 0 || metadata->log_zone_list.empty()) {
+            return false;
+        }
+        bool idle = microseconds_since_epoch() - metadata->fg_last_us >= GC_IDLE_US;
+        if (gc_urgency(metadata) == 0) {
+            if (!metadata->gc_adaptive || !idle) {
+                return false;
             }
+            ingest_sample(metadata);
+            int64_t room = log_zones_free(metadata) - (int64_t)metadata->gc_watermark;
+            uint32_t most = std::max<int64_t>(1, (int64_t)metadata->log_zone_num_config - metadata->gc_watermark - 1);
+            return room < std::min<int64_t>(most, 2 * gc_slack_zones(metadata));
         }
+        return metadata->gc_tokens >= 0 || idle;
+    }
 
-        return 0;
+    // a foreground command of some blocks went through, the caller holds the gc_mutex
+    void gc_credit(struct zns_ftl *metadata, uint32_t blocks) {
+        metadata->fg_last_us = microseconds_since_epoch();
+        if (metadata->gc_bw_pct == 0) {
+            return;
+        }
+        if (metadata->gc_adaptive) {
+            ingest_sample(metadata);
+        }
+        double u = gc_urgency(metadata);
+        if (u == 0) {
+            return;
+        }
+        double share = metadata->gc_bw_pct / 100.0;
+        share = std::min(0.95, share + (1 - share) * u * u);
+        metadata->gc_tokens = std::min<double>(metadata->gc_tokens + blocks * share / (1 - share), 2.0 * metadata->n_blocks_per_zone);
+        if (metadata->gc_tokens >= 0) {
+            gc_kick(metadata);
+        }
     }
 
-    int zns_udevice_read(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size) {
-        if (size % my_dev->lba_size_bytes) {
-            printf("INVALID: read size not aligned to block size\n");
-            return -1;
+    /**
+    * Free zone pool
+    * Zones given up by the log or by a merge are queued for a reset task, which resets them in batches
+    * off the foreground path and moves them to the pool of pre-erased zones. Allocation just pops the
+    * pool, it only ever waits when the pool is empty while resets are still pending. Reset tasks are
+    * urgent on the executor, they never queue behind GC tasks that may be stuck on the gc_mutex the
+    * waiting allocation holds.
+    */
+    void reset_task(void *args);
+
+    // have a reset task work off the queue, the caller holds the reset_mutex
+    void reset_kick(struct zns_ftl *metadata) {
+        if (metadata->reset_stop || metadata->reset_scheduled) {
+            return;
         }
+        metadata->reset_scheduled = true;
+        ss_executor_submit_urgent(bg_executor, reset_task, metadata);
+    }
 
-        int32_t ret, lba_s = my_dev->lba_size_bytes;
-        uint32_t blocks = size / lba_s, num_read = 0;
-        auto *metadata = (struct zns_device_metadata *)my_dev->_private;
-        for (uint64_t i = address; i < address + blocks * lba_s; i += lba_s) {
-            uint64_t entry;
-            bool read_data = true;
-            if ((log_zone_mapping.find(i) != log_zone_mapping.end())) {
-                entry = log_zone_mapping[i];
-                read_data = (entry & (1L << 63));
+    void queue_zone_reset(struct zns_ftl *metadata, uint32_t zone_no) {
+        pthread_mutex_lock(&metadata->reset_mutex);
+        metadata->reset_queue.push_back(zone_no);
+        reset_kick(metadata);
+        pthread_mutex_unlock(&metadata->reset_mutex);
+    }
+
+    // reset the queued zones, the caller holds the reset_mutex, which is let go while the resets run
+    static void reset_batch(struct zns_ftl *metadata) {
+        std::vector<uint32_t> batch(metadata->reset_queue.begin(), metadata->reset_queue.end());
+        metadata->reset_queue.clear();
+        metadata->resets_in_flight += batch.size();
+        pthread_mutex_unlock(&metadata->reset_mutex);
+
+        for (uint32_t zone_no : batch) {
+            int ret = zone_reset(metadata, metadata->zones[zone_no].slba);
+            pthread_mutex_lock(&metadata->reset_mutex);
+            // a zone that does not reset is left out of the pool for good
+            if (ret == 0) {
+                metadata->free_zones.push_back(zone_no);
             }
+            metadata->resets_in_flight--;
+            pthread_cond_broadcast(&metadata->zone_freed);
+            pthread_mutex_unlock(&metadata->reset_mutex);
+        }
+        pthread_mutex_lock(&metadata->reset_mutex);
+    }
 
-            if (read_data) {
-                uint64_t zone_number = ((i) / (zns_metadata->n_blocks_per_zone * zns_device->lba_size_bytes)) + zns_metadata->log_zone_num_config;
-                if (!(data_zone_mapping.find(zone_number) != data_zone_mapping.end())) {
-                    memset(buffer, 0, size);
-                    return 0;
-                }
+    // take the least (or the most) worn zone out of the pool, the caller holds the reset_mutex and the pool is not empty
+    uint32_t take_free_zone(struct zns_ftl *metadata, bool most_worn) {
+        auto pick = metadata->free_zones.begin();
+        for (auto it = metadata->free_zones.begin(); it != metadata->free_zones.end(); it++) {
+            if (most_worn ? metadata->zone_resets[*it] > metadata->zone_resets[*pick] : metadata->zone_resets[*it] < metadata->zone_resets[*pick]) {
+                pick = it;
+            }
+        }
+        uint32_t zone_no = *pick;
+        metadata->free_zones.erase(pick);
+        return zone_no;
+    }
 
-                entry = data_zone_mapping[zone_number] + ((i) % (zns_metadata->n_blocks_per_zone * zns_device->lba_size_bytes) / zns_device->lba_size_bytes);
+    // find the next empty zone address, the least worn one, -1 if there is none and no reset can produce one
+    int64_t next_empty_zone(struct zns_ftl *metadata) {
+        pthread_mutex_lock(&metadata->reset_mutex);
+        while (metadata->free_zones.empty() && (!metadata->reset_queue.empty() || metadata->resets_in_flight > 0)) {
+            // once deinit stopped the reset tasks, what is left is reset here
+            if (metadata->reset_stop && !metadata->reset_queue.empty()) {
+                reset_batch(metadata);
+                continue;
             }
+            reset_kick(metadata);
+            pthread_cond_wait(&metadata->zone_freed, &metadata->reset_mutex);
+        }
+        if (metadata->free_zones.empty()) {
+            pthread_mutex_unlock(&metadata->reset_mutex);
+            return -1;
+        }
+        uint32_t zone_no = take_free_zone(metadata, false);
+        pthread_mutex_unlock(&metadata->reset_mutex);
+        return metadata->zones[zone_no].slba;
+    }
 
-            if (size < metadata->mdts) {
-                ret = nvme_read(metadata->fd, metadata->nsid, (entry & ~(1L << 63)), 0, 0, 0, 0, 0, 0, lba_s, (char *)buffer + num_read, 0, NULL);
-                if (ret) {
-                    printf("ERROR: failed to read at 0x%lx, ret: %d\n", entry & ~(1L << 63), ret);
-                    return ret;
-                }
-                num_read += lba_s;
+    // wait until every queued reset is done, so the mirror is quiet (used by the consistency check and deinit)
+    void drain_zone_resets(struct zns_ftl *metadata) {
+        pthread_mutex_lock(&metadata->reset_mutex);
+        while (!metadata->reset_queue.empty() || metadata->resets_in_flight > 0) {
+            if (!metadata->reset_queue.empty()) {
+                reset_batch(metadata);
             } else {
-                ret = io_with_mdts(metadata->fd, metadata->nsid, (entry & ~(1L << 63)), (char *)buffer + num_read, size, true);
-                if (ret) {
-                    printf("ERROR: failed to read at 0x%lx, ret: %d\n", entry & ~(1L << 63), ret);
-                    return ret;
-                }
-                num_read += lba_s;
+                pthread_cond_wait(&metadata->zone_freed, &metadata->reset_mutex);
             }
         }
+        pthread_mutex_unlock(&metadata->reset_mutex);
+    }
 
-        return 0;
+    void reset_task(void *args) {
+        struct zns_ftl *metadata = (struct zns_ftl *)args;
+        pthread_mutex_lock(&metadata->reset_mutex);
+        while (!metadata->reset_queue.empty()) {
+            reset_batch(metadata);
+        }
+        metadata->reset_scheduled = false;
+        pthread_mutex_unlock(&metadata->reset_mutex);
     }
 
-    int zns_udevice_write(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size)  {
-        if (size % my_dev->lba_size_bytes) {
-            printf("INVALID: write size not aligned to block size\n");
-            return -1;
+    // number of leading blocks of the logical zone that one log zone holds in order, from its start, and nothing
+    // else. Such a zone can become the data zone as it is (all blocks) or after its tail is filled in
+    uint32_t log_prefix_zone(struct zns_ftl *metadata, std::unordered_map<int64_t, int64_t> &map, int64_t *zone_no) {
+        auto first = map.find(0);
+        if (first == map.end()) {
+            return 0;
+        }
+        struct zns_zone_info *zone = &metadata->zones[first->second / metadata->n_blocks_per_zone];
+        uint64_t prefix = zone->wp - zone->slba;
+        if (first->second != (int64_t)zone->slba || metadata->valid_blocks[zone->slba / metadata->n_blocks_per_zone] != prefix) {
+            return 0;
         }
+        for (uint64_t i = 1; i < prefix; i++) {
+            auto entry = map.find(i);
+            if (entry == map.end() || entry->second != (int64_t)(zone->slba + i)) {
+                return 0;
+            }
+        }
+        *zone_no = zone->slba / metadata->n_blocks_per_zone;
+        return prefix;
+    }
 
-        auto *metadata = (struct zns_device_metadata *)my_dev->_private;
-        uint32_t blocks = size / my_dev->lba_size_bytes;
-        __u64 lba_result = 0;
-        // Starting lock here
-        // zns_metadata has to be consistent throughout the program, hence declaring it globally instead of passing metadata by reference.
-        pthread_mutex_lock(&zns_metadata->gc_mutex);
-        while (free_zone_number(blocks) <= metadata->gc_watermark) {
-            zns_metadata->trigger_my_gc = true;
-            pthread_cond_signal(&zns_metadata->start_gc);
-            pthread_cond_wait(&zns_metadata->stop_gc, &zns_metadata->gc_mutex);
+    // give a log stream a fresh zone from the pool, returns it or -1
+    int64_t log_stream_open(struct zns_ftl *metadata, int stream) {
+        int64_t slba = next_empty_zone(metadata);
+        if (slba == -1) {
+            return -1;
         }
+        int64_t zone_no = slba / metadata->n_blocks_per_zone;
+        metadata->log_stream_zone[stream] = zone_no;
+        metadata->zone_gc_age[zone_no] = stream >= LOG_STREAM_GC ? stream - LOG_STREAM_GC + 1 : 0;
+        metadata->log_zone_list.push_back(zone_no);
+        return zone_no;
+    }
 
-        int32_t ret, prev_log_zone_end = metadata->log_zone_end, zone_no = metadata->log_zone_end / metadata->n_blocks_per_zone;
-        
-        if (size < metadata->mdts) {
-            ret = nvme_zns_append(metadata->fd, metadata->nsid, zone_no * metadata->n_blocks_per_zone, blocks - 1, 0, 0, 0, 0, size, buffer, 0, NULL, &lba_result);
-            if (ret != 0) {
-                printf("[ERROR] FAILED TO WRITE TO DEVICE: %d\n", ret);
-                return ret;
-            }
-            
-            metadata->log_zone_end = lba_result + 1;
-        } else {
-            ret = io_with_mdts(metadata->fd, metadata->nsid, zone_no * metadata->n_blocks_per_zone, buffer, size, false);
-            if (ret != 0) {
-                printf("[ERROR] FAILED TO WRITE TO DEVICE: %d\n", ret);
-                return ret;
+    // a log zone that now holds data leaves the log
+    void log_zone_retire(struct zns_ftl *metadata, uint32_t zone_no) {
+        metadata->log_zone_list.erase(std::find(metadata->log_zone_list.begin(), metadata->log_zone_list.end(), zone_no));
+        for (int s = 0; s < N_LOG_STREAMS; s++) {
+            if (metadata->log_stream_zone[s] == zone_no) {
+                metadata->log_stream_zone[s] = -1;
             }
         }
+    }
 
-        for (uint32_t i = 0; i < blocks; i++) {
-            log_zone_mapping[address + i * my_dev->lba_size_bytes] = prev_log_zone_end + i;
-        }
+    /**
+    * Sub-zone chunks
+    * With chunk_blocks set a logical zone is also cut into chunks, the last one may be shorter. A merge whose
+    * log blocks fall into few chunks writes only those, each to a slot of the chunk area, and the copy there
+    * replaces that part of the data zone. Reads look for a chunk before they go to the data zone. Once half
+    * of a logical zone would be in chunks, or the area has no room, the zone is merged as a whole again and
+    * its chunks are dropped. The area is written like the log: chunks are appended to its open zone, a zone
+    * goes back to the pool once none of its chunks is mapped, and when the area runs short of room the live
+    * chunks of its emptiest zone move on at the end of a GC pass.
+    */
+    uint32_t chunks_per_zone(struct zns_ftl *metadata) {
+        return (metadata->n_blocks_per_zone + metadata->chunk_blocks - 1) / metadata->chunk_blocks;
+    }
 
-        pthread_mutex_unlock(&zns_metadata->gc_mutex);
-        return 0;
+    uint32_t chunk_len(struct zns_ftl *metadata, uint32_t chunk) {
+        return std::min(metadata->chunk_blocks, metadata->n_blocks_per_zone - chunk * metadata->chunk_blocks);
+    }
+
+    // a chunk of a logical zone as the chunk mapping knows it
+    int64_t chunk_key(struct zns_ftl *metadata, int64_t lzone, uint32_t chunk) {
+        return (lzone - metadata->log_zone_num_config) * chunks_per_zone(metadata) + chunk;
+    }
+
+    // chunk slots the chunk area has left, a slot takes a chunk of any length
+    uint64_t chunk_area_room(struct zns_ftl *metadata) {
+        uint64_t slots = metadata->n_blocks_per_zone / metadata->chunk_blocks;
+        uint64_t room = (metadata->chunk_zone_num_config - std::min<uint64_t>(metadata->chunk_zone_list.size(), metadata->chunk_zone_num_config)) * slots;
+        if (metadata->chunk_zone != -1) {
+            struct zns_zone_info *zone = &metadata->zones[metadata->chunk_zone];
+            room += (zone->slba + zone->cap - metadata->chunk_next) / metadata->chunk_blocks;
+        }
+        return room;
+    }
+
+    // a slot for a chunk of len blocks, the caller holds the gc_mutex. Returns its LBA, -1 if the area is full
+    int64_t chunk_alloc(struct zns_ftl *metadata, uint32_t len) {
+        if (metadata->chunk_zone != -1) {
+            struct zns_zone_info *zone = &metadata->zones[metadata->chunk_zone];
+            if (metadata->chunk_next + len > zone->slba + zone->cap) {
+                metadata->chunk_zone = -1;
+            }
+        }
+        if (metadata->chunk_zone == -1) {
+            if (metadata->chunk_zone_list.size() >= metadata->chunk_zone_num_config) {
+                return -1;
+            }
+            int64_t slba = next_empty_zone(metadata);
+            if (slba == -1) {
+                return -1;
+            }
+            metadata->chunk_zone = slba / metadata->n_blocks_per_zone;
+            metadata->chunk_next = slba;
+            metadata->chunk_zone_list.push_back(metadata->chunk_zone);
+        }
+        int64_t slba = metadata->chunk_next;
+        metadata->chunk_next += len;
+        return slba;
+    }
+
+    // zones of the chunk area without a mapped chunk go back to the pool. GC calls this between merges only:
+    // the zone a chunk merge is copying into has no mapped chunk of that merge yet
+    void chunk_area_sweep(struct zns_ftl *metadata) {
+        for (auto it = metadata->chunk_zone_list.begin(); it != metadata->chunk_zone_list.end();) {
+            if (metadata->valid_blocks[*it] == 0 && *it != metadata->chunk_zone) {
+                queue_zone_reset(metadata, *it);
+                it = metadata->chunk_zone_list.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+
+    // the data zone of the logical zone was replaced or given back, its chunks go with it
+    void chunk_drop(struct zns_ftl *metadata, int64_t lzone) {
+        if (metadata->chunk_mapping.empty()) {
+            return;
+        }
+        for (uint32_t c = 0; c < chunks_per_zone(metadata); c++) {
+            auto chunk = metadata->chunk_mapping.find(chunk_key(metadata, lzone, c));
+            if (chunk != metadata->chunk_mapping.end()) {
+                metadata->valid_blocks[chunk->second / metadata->n_blocks_per_zone] -= chunk_len(metadata, c);
+                metadata->chunk_mapping.erase(chunk);
+            }
+        }
+    }
+
+    bool block_trimmed(struct zns_ftl *metadata, int64_t lzone, uint32_t offset) {
+        auto dead = metadata->trimmed_zones.find(lzone);
+        return dead != metadata->trimmed_zones.end() && dead->second.blocks[offset];
+    }
+
+    // blocks written again are live, the caller holds the gc_mutex
+    void trim_forget(struct zns_ftl *metadata, uint64_t address, uint32_t blocks) {
+        uint64_t lsb = metadata->dev->lba_size_bytes, zone_bytes = (uint64_t)metadata->n_blocks_per_zone * lsb;
+        for (uint64_t i = address; i < address + (uint64_t)blocks * lsb && !metadata->trimmed_zones.empty(); i += lsb) {
+            auto dead = metadata->trimmed_zones.find(i / zone_bytes + metadata->log_zone_num_config);
+            uint32_t offset = (i % zone_bytes) / lsb;
+            if (dead != metadata->trimmed_zones.end() && dead->second.blocks[offset]) {
+                dead->second.blocks[offset] = false;
+                if (--dead->second.count == 0) {
+                    metadata->trimmed_zones.erase(dead);
+                }
+            }
+        }
+    }
+
+    // a logical zone trimmed or zeroed as a whole gives its data zone back. The set stays while a merge is copying,
+    // the merge could still install a zone with the old blocks in it
+    void trim_release(struct zns_ftl *metadata, int64_t lzone) {
+        auto dead = metadata->trimmed_zones.find(lzone);
+        if (dead == metadata->trimmed_zones.end() || dead->second.count < metadata->n_blocks_per_zone) {
+            return;
+        }
+        auto data = metadata->data_zone_mapping.find(lzone);
+        if (data != metadata->data_zone_mapping.end()) {
+            queue_zone_reset(metadata, data->second / metadata->n_blocks_per_zone);
+            metadata->data_zone_mapping.erase(data);
+            chunk_drop(metadata, lzone);
+            metadata->stats.trim_zones_reclaimed++;
+        }
+        if (metadata->merge_zones == 0) {
+            metadata->trimmed_zones.erase(dead);
+        }
+    }
+
+    /**
+    * Merge of one logical zone
+    * every merged logical zone takes all of its log blocks along, their mappings are dropped.
+    * switch merge: a log zone holds the whole logical zone in order and just becomes the data zone.
+    * partial merge: it holds an in-order prefix, only the tail is copied in behind it.
+    * full merge: old data and log blocks are combined into a fresh zone.
+    * chunk merge: only the chunks the log blocks fall into are combined, into slots of the chunk area.
+    * The merge is planned under the gc_mutex, the copy runs without it so user I/O is served meanwhile
+    * (the I/O scheduler puts it ahead of the copy), and the result is installed under the gc_mutex again.
+    * Blocks overwritten during the copy keep their new log mapping, a data zone replaced during the copy
+    * (by a sequential run) makes the merge give up.
+    */
+    enum { MERGE_SWITCH, MERGE_PARTIAL, MERGE_FULL, MERGE_IN_PLACE, MERGE_CHUNK };
+
+    struct merge_plan {
+        int64_t lzone;
+        // offset in the logical zone -> log LBA, as it was when planned
+        std::unordered_map<int64_t, int64_t> map;
+        // data zone when planned, -1 if there was none, and its blocks trimmed then
+        int64_t prev_zone;
+        std::vector<bool> trimmed;
+        // the blocks of map that are packed, by offset
+        std::unordered_map<int64_t, struct packed_block> packed;
+        // checksums of the whole logical zone when planned, empty if they are not verified. The first run_len
+        // blocks were in the zone of a sequential run then, what a merge copies for them the run replaces
+        std::vector<uint32_t> crcs;
+        uint32_t run_len;
+        // the zone that becomes the data zone, and how many of its blocks are in place already
+        int64_t dest;
+        uint32_t start;
+        int kind;
+        // switch and partial: the zone taken over from the log
+        int64_t log_zone;
+        // static wear leveling: the data moves to dest, given by the caller, even if the log holds none of it
+        bool wear;
+        // copies of chunks of the logical zone in the chunk area when planned, by chunk
+        std::unordered_map<uint32_t, int64_t> chunks;
+        // chunks to move along even if the log holds none of their blocks (the chunk area is cleaned), and
+        // for a chunk merge the chunks it writes with the slot each got
+        std::vector<uint32_t> relocate;
+        std::vector<std::pair<uint32_t, int64_t>> dirty;
+    };
+
+    // compress one block into out, which has room for a block. Returns the packed length, the block size
+    // when it does not shrink enough to be worth unpacking later, then out holds the block as it is
+    uint32_t block_compress(struct zns_ftl *metadata, const char *block, uint32_t size, char *out) {
+#ifdef STOSYS_ZLIB
+        deflateReset(&metadata->block_deflater);
+        metadata->block_deflater.next_in = (Bytef *)block;
+        metadata->block_deflater.avail_in = size;
+        metadata->block_deflater.next_out = (Bytef *)out;
+        metadata->block_deflater.avail_out = size;
+        // deflate only gets to the end if the output fits in a block
+        if (deflate(&metadata->block_deflater, Z_FINISH) != Z_STREAM_END || size - metadata->block_deflater.avail_out > size - size / 8) {
+            memcpy(out, block, size);
+            return size;
+        }
+        return size - metadata->block_deflater.avail_out;
+#else
+        // never called, a build without zlib does not compress
+        UNUSED(metadata);
+        memcpy(out, block, size);
+        return size;
+#endif
+    }
+
+    // a packed block to read, from the LBA it starts in, into one block at dest
+    struct packed_io {
+        uint64_t lba;
+        struct packed_block packed;
+        char *dest;
+    };
+
+    // read packed blocks in one batch and unpack them, returns the LBAs read or an error
+    int64_t packed_readv(struct zns_ftl *metadata, int io_class, std::vector<struct packed_io> &ios) {
+        if (ios.empty()) {
+            return 0;
+        }
+        uint32_t lsb = metadata->dev->lba_size_bytes;
+        // a packed block spans two LBAs at most
+        std::vector<char> span((uint64_t)ios.size() * 2 * lsb);
+        std::vector<struct ss_io_vec> vec;
+        int64_t nlb = 0;
+        for (size_t i = 0; i < ios.size(); i++) {
+            uint32_t n = (ios[i].packed.offset + ios[i].packed.len + lsb - 1) / lsb;
+            vec.push_back({ios[i].lba, n, span.data() + i * 2 * lsb});
+            nlb += n;
+        }
+        int ret = ss_io_readv(metadata->io_sched, io_class, vec.data(), vec.size());
+        if (ret) {
+            printf("ERROR: failed to read packed blocks, ret: %d\n", ret);
+            return ret;
+        }
+        for (size_t i = 0; i < ios.size(); i++) {
+            const char *src = span.data() + i * 2 * lsb + ios[i].packed.offset;
+            if (ios[i].packed.len == lsb) {
+                memcpy(ios[i].dest, src, lsb);
+                continue;
+            }
+#ifdef STOSYS_ZLIB
+            uLongf len = lsb;
+            if (uncompress((Bytef *)ios[i].dest, &len, (const Bytef *)src, ios[i].packed.len) == Z_OK && len == lsb) {
+                continue;
+            }
+#endif
+            printf("ERROR: packed block at LBA 0x%lx does not unpack\n", ios[i].lba);
+            return -EIO;
+        }
+        return nlb;
+    }
+
+    // where on the device (in bytes) the log block of address mapped to lba starts
+    int64_t log_phys(struct zns_ftl *metadata, uint64_t address, int64_t lba) {
+        auto p = metadata->packed_blocks.find(address);
+        return lba * metadata->dev->lba_size_bytes + (p == metadata->packed_blocks.end() ? 0 : p->second.offset);
+    }
+
+    // one more log mapping points at the block at phys
+    void dedup_register(struct zns_ftl *metadata, int64_t phys, uint64_t fp, uint32_t len) {
+        struct dedup_ref *ref = &metadata->dedup_refs[phys];
+        if (ref->refs == 0) {
+            ref->fp = fp;
+            ref->len = len;
+        }
+        ref->refs++;
+        // the index keeps the copy it has
+        metadata->dedup_index.emplace(fp, phys);
+    }
+
+    // one log mapping less points at the block at phys, the last one takes it out of the index
+    void dedup_unref(struct zns_ftl *metadata, int64_t phys) {
+        auto ref = metadata->dedup_refs.find(phys);
+        if (ref == metadata->dedup_refs.end() || --ref->second.refs > 0) {
+            return;
+        }
+        auto idx = metadata->dedup_index.find(ref->second.fp);
+        if (idx != metadata->dedup_index.end() && idx->second == phys) {
+            metadata->dedup_index.erase(idx);
+        }
+        metadata->dedup_refs.erase(ref);
+    }
+
+    // the log mapping of address to lba goes away or is replaced, the caller changes the mapping itself
+    void log_release(struct zns_ftl *metadata, uint64_t address, int64_t lba) {
+        metadata->valid_blocks[lba / metadata->n_blocks_per_zone]--;
+        if (!metadata->dedup_refs.empty()) {
+            dedup_unref(metadata, log_phys(metadata, address, lba));
+        }
+    }
+
+    // CRC32C (Castagnoli), with the CRC instructions of SSE4.2 or ARMv8 when the CPU has them, else by table
+    static uint32_t crc32c_table[256];
+
+    static uint32_t crc32c_soft(uint32_t crc, const char *data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            crc = crc32c_table[(crc ^ (uint8_t)data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+#if defined(__x86_64__)
+    __attribute__((target("sse4.2")))
+    static uint32_t crc32c_hw(uint32_t crc, const char *data, size_t size) {
+        uint64_t c = crc;
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            c = _mm_crc32_u64(c, word);
+        }
+        for (; i < size; i++) {
+            c = _mm_crc32_u8((uint32_t)c, data[i]);
+        }
+        return c;
+    }
+
+    static bool crc32c_hw_present() {
+        return __builtin_cpu_supports("sse4.2");
+    }
+#elif defined(__aarch64__)
+    __attribute__((target("+crc")))
+    static uint32_t crc32c_hw(uint32_t crc, const char *data, size_t size) {
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            crc = __crc32cd(crc, word);
+        }
+        for (; i < size; i++) {
+            crc = __crc32cb(crc, data[i]);
+        }
+        return crc;
+    }
+
+    static bool crc32c_hw_present() {
+        return getauxval(AT_HWCAP) & HWCAP_CRC32;
+    }
+#else
+    static uint32_t crc32c_hw(uint32_t crc, const char *data, size_t size) {
+        return crc32c_soft(crc, data, size);
+    }
+
+    static bool crc32c_hw_present() {
+        return false;
+    }
+#endif
+
+    // the table and the choice are the same for every device, made once by whichever device needs them first
+    static uint32_t (*crc32c_update)(uint32_t crc, const char *data, size_t size) = crc32c_soft;
+    static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+    static void crc32c_setup() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (crc & 1 ? 0x82f63b78 : 0);
+            }
+            crc32c_table[i] = crc;
+        }
+        crc32c_update = crc32c_hw_present() ? crc32c_hw : crc32c_soft;
+    }
+
+    uint32_t block_crc(const char *block, uint32_t size) {
+        return ~crc32c_update(~0u, block, size);
+    }
+
+    // check blocks read back for address against the checksums they were written with, returns how many differ
+    uint32_t blocks_verify(struct zns_ftl *metadata, uint64_t address, const char *data, uint32_t blocks, const uint32_t *crcs) {
+        uint32_t lsb = metadata->dev->lba_size_bytes, bad = 0;
+        for (uint32_t i = 0; i < blocks; i++) {
+            if (block_crc(data + (uint64_t)i * lsb, lsb) != crcs[i]) {
+                printf("ERROR: checksum mismatch at 0x%lx, the block is corrupt\n", address + (uint64_t)i * lsb);
+                bad++;
+            }
+        }
+        return bad;
+    }
+
+    // where block off of the logical zone of a plan is outside the log: in its chunk if that was rewritten, else in the data zone
+    int64_t merge_base(struct zns_ftl *metadata, struct merge_plan *plan, uint32_t off) {
+        if (!plan->chunks.empty()) {
+            auto chunk = plan->chunks.find(off / metadata->chunk_blocks);
+            if (chunk != plan->chunks.end()) {
+                return chunk->second + off % metadata->chunk_blocks;
+            }
+        }
+        return plan->prev_zone + off;
+    }
+
+    // read the blocks [start, end) of a logical zone as they are now into buffer: from the log where it
+    // has them, else from the chunk area or the old data zone unless trimmed, else zeroes
+    int merge_read(struct zns_ftl *metadata, struct merge_plan *plan, uint32_t start, uint32_t end, char *buffer) {
+        int64_t ret = 0, prev_zone = plan->prev_zone;
+        const std::vector<bool> &trimmed = plan->trimmed;
+        uint64_t num_blocks = metadata->n_blocks_per_zone, lsb = metadata->dev->lba_size_bytes;
+        if (prev_zone != -1) {
+            // in runs that are contiguous on the device, the whole range at once when no chunk was rewritten
+            for (uint32_t off = start; off < end;) {
+                int64_t src = merge_base(metadata, plan, off);
+                uint32_t n = 1;
+                while (off + n < end && merge_base(metadata, plan, off + n) == src + n) {
+                    n++;
+                }
+                ret = io_with_mdts(metadata, SS_IO_GC, src, buffer + (off - start) * lsb, n * lsb, true);
+                if (ret) {
+                    printf("ERROR: failed to read data zone at 0x%lx, ret: %ld\n", src, ret);
+                    return ret;
+                }
+                off += n;
+            }
+            metadata->merge_io.gc_read_blocks += end - start;
+            for (uint32_t off = start; off < std::min<uint32_t>(end, trimmed.size()); off++) {
+                if (trimmed[off]) {
+                    memset(buffer + (off - start) * lsb, 0, lsb);
+                }
+            }
+        } else {
+            // never written before, what the log does not cover reads back as zeroes
+            memset(buffer, 0, (end - start) * lsb);
+        }
+        // the log blocks go down in one batch, in device order, so the runs the log holds in order are read in one go
+        std::vector<struct ss_io_vec> vec;
+        std::vector<struct packed_io> packed;
+        for (uint32_t off = start; off < end && !plan->map.empty(); off++) {
+            auto j = plan->map.find(off);
+            if (j == plan->map.end()) {
+                continue;
+            }
+            auto p = plan->packed.find(off);
+            if (p != plan->packed.end()) {
+                packed.push_back({(uint64_t)j->second, p->second, buffer + lsb * (off - start)});
+            } else {
+                vec.push_back({(uint64_t)j->second, 1, buffer + lsb * (off - start)});
+            }
+        }
+        std::sort(vec.begin(), vec.end(), [](const struct ss_io_vec &a, const struct ss_io_vec &b) { return a.slba < b.slba; });
+        ret = ss_io_readv(metadata->io_sched, SS_IO_GC, vec.data(), vec.size());
+        if (ret) {
+            printf("ERROR: failed to read log blocks, ret: %ld\n", ret);
+            return ret;
+        }
+        metadata->merge_io.gc_read_blocks += vec.size();
+        ret = packed_readv(metadata, SS_IO_GC, packed);
+        if (ret < 0) {
+            return ret;
+        }
+        metadata->merge_io.gc_read_blocks += ret;
+        // a corrupt block is copied as it is, its checksum stays and the user read still fails
+        uint32_t from = std::max<uint32_t>(start, plan->run_len);
+        if (!plan->crcs.empty() && from < end) {
+            uint64_t zone_base = (plan->lzone - metadata->log_zone_num_config) * num_blocks * lsb;
+            metadata->merge_io.checksum_errors += blocks_verify(metadata, zone_base + from * lsb, buffer + (from - start) * lsb, end - from,
+                                                      plan->crcs.data() + from);
+        }
+        return 0;
+    }
+
+    struct copy_cmd {
+        struct zns_ftl *metadata;
+        uint64_t dest;
+        std::vector<struct nvme_copy_range> *desc;
+    };
+
+    static int copy_ranges_cmd(void *arg) {
+        auto *cmd = (struct copy_cmd *)arg;
+        // cdw12: number of ranges (0's based), descriptor format 0
+        __u32 cdw12 = (cmd->desc->size() - 1) & 0xff;
+        return nvme_io_passthru(cmd->metadata->fd, nvme_cmd_copy, 0, 0, cmd->metadata->nsid, 0, 0,
+                                cmd->dest & 0xffffffff, cmd->dest >> 32, cdw12, 0, 0, 0,
+                                cmd->desc->size() * sizeof(struct nvme_copy_range), cmd->desc->data(), 0, NULL, 0, NULL);
+    }
+
+    // one NVMe Copy into dest, from the ranges given as (slba, nlb) pairs
+    int copy_ranges(struct zns_ftl *metadata, uint64_t dest, std::vector<std::pair<uint64_t, uint32_t>> &ranges) {
+        std::vector<struct nvme_copy_range> desc(ranges.size());
+        memset(desc.data(), 0, desc.size() * sizeof(struct nvme_copy_range));
+        for (size_t i = 0; i < ranges.size(); i++) {
+            desc[i].slba = htole64(ranges[i].first);
+            desc[i].nlb = htole16(ranges[i].second - 1);
+        }
+        struct copy_cmd cmd = {metadata, dest, &desc};
+        return ss_io_cmd(metadata->io_sched, SS_IO_GC, copy_ranges_cmd, &cmd);
+    }
+
+    // write the current blocks [start + *done, end) of a logical zone at dest_slba + *done, where dest_slba takes
+    // block start, using NVMe Copy, so the data never crosses the host. Blocks nobody wrote yet, or trimmed, are
+    // written as zeroes. *done is moved along with what made it to the device
+    int merge_copy(struct zns_ftl *metadata, struct merge_plan *plan, uint32_t start, uint32_t end, uint64_t dest_slba, uint32_t *done) {
+        static char zeroes[MDTS] = {0};
+        std::unordered_map<int64_t, int64_t> &map = plan->map;
+        const std::vector<bool> &trimmed = plan->trimmed;
+        int64_t prev_zone = plan->prev_zone;
+        uint32_t lsb = metadata->dev->lba_size_bytes;
+        std::vector<std::pair<uint64_t, uint32_t>> ranges;
+        uint32_t pending = 0;
+        int ret = 0;
+
+        auto flush = [&]() {
+            if (ranges.empty()) {
+                return 0;
+            }
+            int r = copy_ranges(metadata, dest_slba + *done, ranges);
+            if (r == 0) {
+                zone_mirror_append(metadata, dest_slba + *done, pending);
+                metadata->merge_io.gc_copy_blocks += pending;
+                metadata->merge_io.gc_write_blocks += pending;
+                *done += pending;
+            }
+            ranges.clear();
+            pending = 0;
+            return r;
+        };
+
+        auto source = [&](uint32_t off) -> int64_t {
+            auto entry = map.find(off);
+            if (entry != map.end()) {
+                return entry->second;
+            }
+            if (prev_zone != -1 && !(off < trimmed.size() && trimmed[off])) {
+                return merge_base(metadata, plan, off);
+            }
+            return -1;
+        };
+
+        for (uint32_t off = start + *done; off < end && ret == 0; off++) {
+            int64_t src = source(off);
+            if (src == -1) {
+                // a run of unwritten blocks, nothing to copy them from
+                ret = flush();
+                uint32_t zeros = 1;
+                while (off + zeros < end && zeros < MDTS / lsb && source(off + zeros) == -1) {
+                    zeros++;
+                }
+                if (ret == 0) {
+                    ret = ss_io_write(metadata->io_sched, SS_IO_GC, dest_slba + (off - start), zeros, zeroes);
+                }
+                if (ret == 0) {
+                    zone_mirror_append(metadata, dest_slba + (off - start), zeros);
+                    metadata->merge_io.gc_write_blocks += zeros;
+                    *done += zeros;
+                }
+                off += zeros - 1;
+                continue;
+            }
+
+            // extend the last range if the source continues it, else start a new one
+            if (!ranges.empty() && ranges.back().first + ranges.back().second == (uint64_t)src &&
+                ranges.back().second < metadata->copy_max_range_blocks) {
+                ranges.back().second++;
+            } else {
+                if (ranges.size() == metadata->copy_max_ranges) {
+                    ret = flush();
+                    if (ret) {
+                        break;
+                    }
+                }
+                ranges.push_back({(uint64_t)src, 1});
+            }
+            pending++;
+            if (pending == metadata->copy_max_blocks) {
+                ret = flush();
+            }
+        }
+        if (ret == 0) {
+            ret = flush();
+        }
+        return ret;
+    }
+
+    // write the blocks [start, end) of the logical zone of a merge at dest_slba as they are now, Copy offload
+    // first when the device has it, the host copy for what is left. Packed blocks have to be unpacked on the host,
+    // and checksums checked there
+    int merge_fill(struct zns_ftl *metadata, struct merge_plan *plan, uint32_t start, uint32_t end, uint64_t dest_slba, char *buffer) {
+        uint32_t num_blocks = metadata->n_blocks_per_zone, lsb = metadata->dev->lba_size_bytes;
+        uint32_t done = 0;
+        if (metadata->copy_offload && plan->packed.empty() && plan->crcs.empty()) {
+            int ret = merge_copy(metadata, plan, start, end, dest_slba, &done);
+            if (ret == 0) {
+                return 0;
+            }
+            printf("[ERROR] COPY OFFLOAD FAILED: %d, falling back to host copy\n", ret);
+            metadata->copy_offload = false;
+            zone_mirror_refresh(metadata, dest_slba / num_blocks);
+            done = metadata->zones[dest_slba / num_blocks].wp - dest_slba;
+        }
+
+        int ret = merge_read(metadata, plan, start + done, end, buffer);
+        if (ret) {
+            return ret;
+        }
+        ret = io_with_mdts(metadata, SS_IO_GC, dest_slba + done, buffer, (uint64_t)(end - start - done) * lsb, false);
+        if (ret) {
+            printf("ERROR: failed to write zone at 0x%lx, ret: %d\n", dest_slba + done, ret);
+            zone_mirror_refresh(metadata, dest_slba / num_blocks);
+            return ret;
+        }
+        zone_mirror_append(metadata, dest_slba + done, end - start - done);
+        metadata->merge_io.gc_write_blocks += end - start - done;
+        return 0;
+    }
+
+    // a chunk merge if it pays: the chunks the log blocks of the logical zone fall into, with those of
+    // plan->relocate, get slots in the chunk area. Only while that writes at most half of what the merge of
+    // zone_cost blocks would, at most half of the logical zone ends up in chunks, and the area has room.
+    // The caller holds the gc_mutex
+    bool chunk_merge_plan(struct zns_ftl *metadata, struct merge_plan *plan, uint32_t zone_cost) {
+        if (metadata->chunk_zone_num_config == 0 || plan->prev_zone == -1) {
+            return false;
+        }
+        uint32_t n_chunks = chunks_per_zone(metadata);
+        std::vector<bool> dirty(n_chunks, false);
+        for (auto &entry : plan->map) {
+            dirty[entry.first / metadata->chunk_blocks] = true;
+        }
+        for (uint32_t c : plan->relocate) {
+            dirty[c] = true;
+        }
+        uint64_t blocks = 0, count = 0, mapped = plan->chunks.size();
+        for (uint32_t c = 0; c < n_chunks; c++) {
+            if (dirty[c]) {
+                blocks += chunk_len(metadata, c);
+                count++;
+                mapped += (plan->chunks.find(c) == plan->chunks.end());
+            }
+        }
+        if ((plan->relocate.empty() && blocks * 2 > zone_cost) || mapped * 2 > n_chunks) {
+            return false;
+        }
+        chunk_area_sweep(metadata);
+        if (count > chunk_area_room(metadata)) {
+            return false;
+        }
+        for (uint32_t c = 0; c < n_chunks; c++) {
+            if (!dirty[c]) {
+                continue;
+            }
+            int64_t slba = chunk_alloc(metadata, chunk_len(metadata, c));
+            if (slba == -1) {
+                // no zone for the area after all, the slots taken stay unwritten and nothing goes behind them
+                metadata->chunk_zone = -1;
+                plan->dirty.clear();
+                return false;
+            }
+            plan->dirty.push_back({c, slba});
+        }
+        plan->kind = MERGE_CHUNK;
+        return true;
+    }
+
+    // pick the kind of merge and its zone, the caller holds the gc_mutex. Only the in-place merge, when
+    // there is no zone to merge into, does its I/O here: the old data zone is reset before it is rewritten
+    int zone_merge_plan(struct zns_ftl *metadata, struct merge_plan *plan, char *buffer) {
+        int64_t num_blocks = metadata->n_blocks_per_zone, lsb = metadata->dev->lba_size_bytes;
+        auto data = metadata->data_zone_mapping.find(plan->lzone);
+        plan->prev_zone = data == metadata->data_zone_mapping.end() ? -1 : data->second;
+        auto dead = metadata->trimmed_zones.find(plan->lzone);
+        if (dead != metadata->trimmed_zones.end()) {
+            plan->trimmed = dead->second.blocks;
+        }
+        if (plan->prev_zone != -1 && !metadata->chunk_mapping.empty()) {
+            for (uint32_t c = 0; c < chunks_per_zone(metadata); c++) {
+                auto chunk = metadata->chunk_mapping.find(chunk_key(metadata, plan->lzone, c));
+                if (chunk != metadata->chunk_mapping.end()) {
+                    plan->chunks[c] = chunk->second;
+                }
+            }
+        }
+        plan->run_len = 0;
+        if (metadata->checksum == ZNS_CHECKSUM_VERIFY) {
+            auto first = metadata->block_crcs.begin() + (plan->lzone - metadata->log_zone_num_config) * num_blocks;
+            plan->crcs.assign(first, first + num_blocks);
+            for (auto &run : metadata->seq_runs) {
+                if (run.lzone == plan->lzone && run.zone != -1) {
+                    plan->run_len = run.len;
+                }
+            }
+        }
+        plan->log_zone = -1;
+        plan->start = 0;
+        if (plan->wear) {
+            plan->kind = MERGE_FULL;
+            return 0;
+        }
+
+        // a log zone with packed blocks does not hold them at their place in the logical zone
+        uint32_t prefix = plan->packed.empty() ? log_prefix_zone(metadata, plan->map, &plan->log_zone) : 0;
+        if (prefix == num_blocks) {
+            // switch merge, nothing to copy
+            plan->kind = MERGE_SWITCH;
+            plan->dest = metadata->zones[plan->log_zone].slba;
+            plan->start = num_blocks;
+            log_zone_retire(metadata, plan->log_zone);
+            return 0;
+        }
+        if (chunk_merge_plan(metadata, plan, num_blocks - prefix)) {
+            return 0;
+        }
+        if (prefix > 0) {
+            // partial merge, the tail comes from the log or the old data zone. The zone leaves the log
+            // now, so nothing is appended to it while its tail is filled in
+            plan->kind = MERGE_PARTIAL;
+            plan->dest = metadata->zones[plan->log_zone].slba;
+            plan->start = prefix;
+            log_zone_retire(metadata, plan->log_zone);
+            return 0;
+        }
+        plan->kind = MERGE_FULL;
+        plan->dest = next_empty_zone(metadata);
+        if (plan->dest != -1) {
+            return 0;
+        }
+
+        // nothing free, the old data zone gets rewritten in place, through the host as it is reset first
+        if (plan->prev_zone == -1) {
+            printf("ERROR: no free zone to merge logical zone %ld into\n", plan->lzone);
+            return -ENOSPC;
+        }
+        plan->kind = MERGE_IN_PLACE;
+        plan->dest = plan->prev_zone;
+        plan->start = num_blocks;
+        int ret = merge_read(metadata, plan, 0, num_blocks, buffer);
+        if (ret) {
+            return ret;
+        }
+        // this is the one reset that can not be deferred
+        zone_reset(metadata, plan->prev_zone);
+        ret = io_with_mdts(metadata, SS_IO_GC, plan->prev_zone, buffer, num_blocks * lsb, false);
+        if (ret) {
+            printf("ERROR: failed to write zone at 0x%lx, ret: %d, in place\n", plan->prev_zone, ret);
+            return ret;
+        }
+        zone_mirror_append(metadata, plan->prev_zone, num_blocks);
+        metadata->merge_io.gc_write_blocks += num_blocks;
+        return 0;
+    }
+
+    // install the merged zone as the data zone, or give up on it, the caller holds the gc_mutex again
+    int zone_merge_commit(struct zns_ftl *metadata, struct merge_plan *plan, int ret) {
+        int64_t num_blocks = metadata->n_blocks_per_zone, lsb = metadata->dev->lba_size_bytes;
+        auto data = metadata->data_zone_mapping.find(plan->lzone);
+        int64_t now = data == metadata->data_zone_mapping.end() ? -1 : data->second;
+        if (ret != 0 || now != plan->prev_zone) {
+            // the zone taken from the log goes back to it, a fresh one back to the free pool
+            // and a chunk merge that failed leaves a gap in the open zone of the chunk area, it takes no more
+            if (plan->kind == MERGE_FULL) {
+                queue_zone_reset(metadata, plan->dest / num_blocks);
+            } else if (plan->kind == MERGE_PARTIAL) {
+                metadata->log_zone_list.push_back(plan->log_zone);
+            } else if (plan->kind == MERGE_CHUNK && ret != 0) {
+                metadata->chunk_zone = -1;
+            }
+            return ret;
+        }
+
+        if (plan->kind == MERGE_CHUNK) {
+            for (auto &chunk : plan->dirty) {
+                uint32_t len = chunk_len(metadata, chunk.first);
+                int64_t key = chunk_key(metadata, plan->lzone, chunk.first);
+                auto old = metadata->chunk_mapping.find(key);
+                if (old != metadata->chunk_mapping.end()) {
+                    metadata->valid_blocks[old->second / num_blocks] -= len;
+                }
+                metadata->chunk_mapping[key] = chunk.second;
+                metadata->valid_blocks[chunk.second / num_blocks] += len;
+            }
+            metadata->stats.chunk_merges++;
+            metadata->stats.chunk_relocations += plan->relocate.size();
+        } else {
+            metadata->data_zone_mapping[plan->lzone] = plan->dest;
+            if (plan->prev_zone != -1 && plan->prev_zone != plan->dest) {
+                queue_zone_reset(metadata, plan->prev_zone / num_blocks);
+            }
+            // the zone has all of its chunks in it now
+            chunk_drop(metadata, plan->lzone);
+        }
+        switch (plan->kind) {
+            case MERGE_CHUNK:
+                break;
+            case MERGE_SWITCH:
+                metadata->stats.switch_merges++;
+                break;
+            case MERGE_PARTIAL:
+                metadata->stats.partial_merges++;
+                break;
+            default:
+                if (plan->wear) {
+                    metadata->stats.wear_migrations++;
+                } else {
+                    metadata->stats.full_merges++;
+                }
+        }
+
+        // the merged blocks now live in the data zone, unless they were written again since
+        int64_t zone_base = (plan->lzone - metadata->log_zone_num_config) * num_blocks * lsb;
+        // (packed or shared blocks can start in the same LBA, it takes the byte address to tell them apart)
+        for (auto j = plan->map.begin(); j != plan->map.end(); j++) {
+            uint64_t address = zone_base + j->first * lsb;
+            auto entry = metadata->log_zone_mapping.find(address);
+            auto p = plan->packed.find(j->first);
+            int64_t phys = j->second * lsb + (p == plan->packed.end() ? 0 : p->second.offset);
+            if (entry != metadata->log_zone_mapping.end() && log_phys(metadata, address, entry->second) == phys) {
+                log_release(metadata, address, entry->second);
+                metadata->log_zone_mapping.erase(entry);
+                metadata->packed_blocks.erase(address);
+                metadata->log_zone_end--;
+            }
+        }
+        return 0;
+    }
+
+    /**
+    * GC victim policies
+    * A policy scores a log zone, GC takes the zone with the highest score. Zones still open for appends are
+    * only taken when every other zone is open too. Age is counted in blocks written since the zone was last
+    * appended to (write_clock).
+    */
+    typedef double (*gc_policy_score)(struct zns_ftl *metadata, uint32_t zone_no, size_t order);
+
+    uint64_t write_clock(struct zns_ftl *metadata) {
+        return metadata->stats.log_write_blocks + metadata->stats.direct_write_blocks;
+    }
+
+    // greedy: the fewest live blocks, so the merge moves as little as possible
+    static double gc_score_greedy(struct zns_ftl *metadata, uint32_t zone_no, size_t order) {
+        UNUSED(order);
+        return -(double)metadata->valid_blocks[zone_no];
+    }
+
+    // cost-benefit (LFS): free space gained times its age, over the cost of reading and rewriting the live part
+    static double gc_score_cost_benefit(struct zns_ftl *metadata, uint32_t zone_no, size_t order) {
+        UNUSED(order);
+        double u = (double)metadata->valid_blocks[zone_no] / metadata->n_blocks_per_zone;
+        double age = (double)(write_clock(metadata) - metadata->zone_mtime[zone_no]) + 1;
+        if (u == 0) {
+            return HUGE_VAL;
+        }
+        return (1 - u) * age / (2 * u);
+    }
+
+    // age threshold: greedy among the zones left alone for a whole log's worth of writes, the rest only after them
+    static double gc_score_age_threshold(struct zns_ftl *metadata, uint32_t zone_no, size_t order) {
+        UNUSED(order);
+        bool old = write_clock(metadata) - metadata->zone_mtime[zone_no] >= metadata->heat_epoch_blocks;
+        return (old ? metadata->n_blocks_per_zone + 1 : 0) - (double)metadata->valid_blocks[zone_no];
+    }
+
+    // FIFO: the zone opened first, the log is cleaned like a circular buffer
+    static double gc_score_fifo(struct zns_ftl *metadata, uint32_t zone_no, size_t order) {
+        UNUSED(metadata);
+        UNUSED(zone_no);
+        return -(double)order;
+    }
+
+    static const gc_policy_score gc_policies[ZNS_GC_N_POLICIES] = {
+        gc_score_greedy, gc_score_cost_benefit, gc_score_age_threshold, gc_score_fifo
+    };
+
+    int64_t pick_gc_victim(struct zns_ftl *metadata) {
+        gc_policy_score score = gc_policies[metadata->gc_policy];
+        int64_t victim = -1;
+        bool victim_open = true;
+        double victim_score = 0;
+        for (size_t i = 0; i < metadata->log_zone_list.size(); i++) {
+            uint32_t zone_no = metadata->log_zone_list[i];
+            bool open = false;
+            for (int s = 0; s < N_LOG_STREAMS; s++) {
+                open |= (metadata->log_stream_zone[s] == zone_no && metadata->zones[zone_no].state != FULL_ZONE);
+            }
+            double zone_score = score(metadata, zone_no, i);
+            if (victim == -1 || (victim_open && !open) || (open == victim_open && zone_score > victim_score)) {
+                victim = zone_no;
+                victim_open = open;
+                victim_score = zone_score;
+            }
+        }
+        if (victim != -1) {
+            metadata->stats.gc_victim_blocks += metadata->valid_blocks[victim];
+        }
+        return victim;
+    }
+
+    // drop the log copy of a block that was just written somewhere else
+    void log_invalidate(struct zns_ftl *metadata, uint64_t address) {
+        auto entry = metadata->log_zone_mapping.find(address);
+        if (entry != metadata->log_zone_mapping.end()) {
+            log_release(metadata, address, entry->second);
+            metadata->log_zone_mapping.erase(entry);
+            metadata->packed_blocks.erase(address);
+            metadata->log_zone_end--;
+        }
+    }
+
+    // a run that stops being sequential: a candidate is just forgotten, a run with a zone
+    // hands its blocks over to the log, its zone becomes one more log zone for GC
+    void seq_run_close(struct zns_ftl *metadata, size_t idx) {
+        struct seq_run run = metadata->seq_runs[idx];
+        metadata->seq_runs.erase(metadata->seq_runs.begin() + idx);
+        if (run.zone == -1) {
+            return;
+        }
+        uint64_t zone_bytes = (uint64_t)metadata->n_blocks_per_zone * metadata->dev->lba_size_bytes;
+        uint64_t base = (run.lzone - metadata->log_zone_num_config) * zone_bytes;
+        for (uint32_t i = 0; i < run.len; i++) {
+            metadata->log_zone_mapping[base + (uint64_t)i * metadata->dev->lba_size_bytes] = metadata->zones[run.zone].slba + i;
+        }
+        metadata->valid_blocks[run.zone] += run.len;
+        metadata->zone_mtime[run.zone] = write_clock(metadata);
+        metadata->zone_gc_age[run.zone] = 0;
+        metadata->log_zone_end += run.len;
+        metadata->log_zone_list.push_back(run.zone);
+    }
+
+    // a sequential run of the logical zone hands its blocks to the log, before blocks of the zone are mapped some other way
+    void seq_run_end(struct zns_ftl *metadata, int64_t lzone) {
+        for (size_t r = 0; r < metadata->seq_runs.size(); r++) {
+            if (metadata->seq_runs[r].lzone == lzone) {
+                seq_run_close(metadata, r);
+                break;
+            }
+        }
+    }
+
+    // the blocks read back as zeroes from now on, without any device I/O, the caller holds the gc_mutex
+    void blocks_zeroed(struct zns_ftl *metadata, uint64_t address, uint64_t blocks) {
+        uint64_t lsb = metadata->dev->lba_size_bytes, zone_bytes = (uint64_t)metadata->n_blocks_per_zone * lsb;
+        uint64_t end = address + blocks * lsb;
+        for (uint64_t i = address; i < end; i += lsb) {
+            int64_t lzone = i / zone_bytes + metadata->log_zone_num_config;
+            uint32_t offset = (i % zone_bytes) / lsb;
+            if (offset == 0 || i == address) {
+                seq_run_end(metadata, lzone);
+            }
+            log_invalidate(metadata, i);
+            struct trim_set *dead = &metadata->trimmed_zones[lzone];
+            if (dead->blocks.empty()) {
+                dead->blocks.assign(metadata->n_blocks_per_zone, false);
+            }
+            if (!dead->blocks[offset]) {
+                dead->blocks[offset] = true;
+                dead->count++;
+            }
+            if (!metadata->block_crcs.empty()) {
+                metadata->block_crcs[i / lsb] = metadata->zero_block_crc;
+            }
+            if (offset == metadata->n_blocks_per_zone - 1 || i + lsb == end) {
+                trim_release(metadata, lzone);
+            }
+        }
+    }
+
+    // glibc's memcmp is vectorized, comparing the block with itself shifted by a word scans it at SIMD speed
+    bool block_is_zero(const char *block, uint32_t size) {
+        uint64_t first;
+        memcpy(&first, block, sizeof(first));
+        return first == 0 && memcmp(block, block + sizeof(first), size - sizeof(first)) == 0;
+    }
+
+    // fingerprint of a block for dedup: XXH64 (seed 0) over the whole block, the size is a multiple of its 32 byte stripes
+    uint64_t block_fingerprint(const char *block, uint32_t size) {
+        const uint64_t P1 = 11400714785092667905ULL, P2 = 14029467366897019727ULL, P3 = 1609587929392839161ULL,
+                       P4 = 9650029242287828579ULL;
+        auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+        auto mix = [&](uint64_t acc, uint64_t in) { return rotl(acc + in * P2, 31) * P1; };
+        uint64_t v[4] = {P1 + P2, P2, 0, 0 - P1};
+        for (uint32_t i = 0; i < size; i += 32) {
+            for (int lane = 0; lane < 4; lane++) {
+                uint64_t in;
+                memcpy(&in, block + i + lane * 8, sizeof(in));
+                v[lane] = mix(v[lane], in);
+            }
+        }
+        uint64_t h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+        for (int lane = 0; lane < 4; lane++) {
+            h = (h ^ mix(0, v[lane])) * P1 + P4;
+        }
+        h += size;
+        h = (h ^ (h >> 33)) * P2;
+        h = (h ^ (h >> 29)) * P3;
+        return h ^ (h >> 32);
+    }
+
+    // the log block a new block with this fingerprint may be shared with, -1 if there is none. Only blocks in
+    // the newer half of the log zones are shared (none in a zone on its way to become a data zone or in the victim
+    // of a GC pass): a new mapping into an old zone drags its logical zone into that zone's GC pass early
+    int64_t dedup_candidate(struct zns_ftl *metadata, uint64_t fp) {
+        auto idx = metadata->dedup_index.find(fp);
+        if (idx == metadata->dedup_index.end()) {
+            return -1;
+        }
+        int64_t zone_no = idx->second / metadata->dev->lba_size_bytes / metadata->n_blocks_per_zone;
+        auto at = std::find(metadata->log_zone_list.begin(), metadata->log_zone_list.end(), zone_no);
+        if ((metadata->gc_pass_open && zone_no == metadata->gc_victim) || at == metadata->log_zone_list.end() ||
+            (size_t)(at - metadata->log_zone_list.begin()) < metadata->log_zone_list.size() / 2) {
+            return -1;
+        }
+        return idx->second;
+    }
+
+    // the block at address gets the content of the log block at phys, which dedup_lookup found to be the same,
+    // without any write. False if there is none, or the log block is no longer a candidate or changed since it
+    // was seen. The caller holds the gc_mutex
+    bool block_dedup(struct zns_ftl *metadata, uint64_t address, int64_t phys, uint64_t fp, std::unordered_map<int64_t, struct dedup_seen> &seen) {
+        if (phys == -1 || dedup_candidate(metadata, fp) != phys) {
+            return false;
+        }
+        uint32_t lsb = metadata->dev->lba_size_bytes;
+        struct dedup_seen *was = &seen[phys];
+        auto found = metadata->dedup_refs.find(phys);
+        if (found == metadata->dedup_refs.end() || found->second.fp != was->ref.fp || found->second.len != was->ref.len ||
+            found->second.refs != was->ref.refs || __atomic_load_n(&metadata->zone_resets[phys / lsb / metadata->n_blocks_per_zone], __ATOMIC_RELAXED) != was->resets) {
+            return false;
+        }
+        struct dedup_ref *ref = &found->second;
+
+        uint64_t zone_bytes = (uint64_t)metadata->n_blocks_per_zone * lsb;
+        seq_run_end(metadata, address / zone_bytes + metadata->log_zone_num_config);
+        auto entry = metadata->log_zone_mapping.find(address);
+        if (entry != metadata->log_zone_mapping.end()) {
+            if (log_phys(metadata, address, entry->second) == phys) {
+                // written again as it is
+                return true;
+            }
+            log_release(metadata, address, entry->second);
+            entry->second = phys / lsb;
+        } else {
+            metadata->log_zone_mapping[address] = phys / lsb;
+            metadata->log_zone_end++;
+        }
+        if (ref->len) {
+            metadata->packed_blocks[address] = {(uint32_t)(phys % lsb), ref->len};
+        } else {
+            metadata->packed_blocks.erase(address);
+        }
+        ref->refs++;
+        // the write's own share is no change
+        was->ref.refs++;
+        metadata->valid_blocks[phys / lsb / metadata->n_blocks_per_zone]++;
+        return true;
+    }
+
+    // a sequential run of the logical zone goes on at this block
+    bool seq_run_continues(struct zns_ftl *metadata, int64_t lzone, uint32_t offset) {
+        for (auto &run : metadata->seq_runs) {
+            if (run.lzone == lzone && run.len == offset) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+    * GC passes
+    * A pass picks a victim and merges the logical zones that have live blocks in it, one logical zone
+    * (a chunk) at a time. The gc_mutex is let go between chunks, so foreground commands waiting for it
+    * get in before GC goes on. The set of a chunk is built when it is merged, writes in between are seen.
+    */
+    void gc_begin_pass(struct zns_ftl *metadata) {
+        int64_t victim = pick_gc_victim(metadata);
+        metadata->gc_pass_open = true;
+        metadata->gc_victim = victim;
+        metadata->gc_pass_relocated = 0;
+        if (victim == -1) {
+            return;
+        }
+        // an open victim takes no more appends, or the pass would never empty it
+        for (int s = 0; s < N_LOG_STREAMS; s++) {
+            if (metadata->log_stream_zone[s] == victim) {
+                metadata->log_stream_zone[s] = -1;
+            }
+        }
+        int64_t zone_bytes = metadata->n_blocks_per_zone * metadata->dev->lba_size_bytes;
+        // logical zones with live blocks in the victim, each is merged with all of its log blocks
+        std::vector<bool> queued(metadata->n_zones, false);
+        for (auto iteration = metadata->log_zone_mapping.begin(); iteration != metadata->log_zone_mapping.end(); iteration++) {
+            if (iteration->second / (int64_t)metadata->n_blocks_per_zone == victim) {
+                int64_t zone_number = (iteration->first / zone_bytes) + metadata->log_zone_num_config;
+                if (!queued[zone_number]) {
+                    queued[zone_number] = true;
+                    metadata->gc_pending.push_back(zone_number);
+                }
+            }
+        }
+    }
+
+    // the log blocks of the logical zone of a plan
+    void merge_collect(struct zns_ftl *metadata, struct merge_plan *plan) {
+        int64_t zone_bytes = metadata->n_blocks_per_zone * metadata->dev->lba_size_bytes;
+        for (auto iteration = metadata->log_zone_mapping.begin(); iteration != metadata->log_zone_mapping.end(); iteration++) {
+            if ((iteration->first / zone_bytes) + metadata->log_zone_num_config == plan->lzone) {
+                int64_t offset = (iteration->first % zone_bytes) / metadata->dev->lba_size_bytes;
+                plan->map.insert(std::pair<int64_t, int64_t>(offset, iteration->second));
+                auto p = metadata->packed_blocks.find(iteration->first);
+                if (p != metadata->packed_blocks.end()) {
+                    plan->packed[offset] = p->second;
+                }
+            }
+        }
+    }
+
+    // plan, copy and commit a merge, returns the blocks of device I/O it took.
+    // The gc_mutex is let go while the blocks are copied
+    int64_t merge_run(struct zns_ftl *metadata, struct merge_plan *plan) {
+        uint64_t gc_start = microseconds_since_epoch();
+        char *buffer = (char *)malloc((uint64_t)metadata->n_blocks_per_zone * metadata->dev->lba_size_bytes);
+        memset(&metadata->merge_io, 0, sizeof(metadata->merge_io));
+        int ret = zone_merge_plan(metadata, plan, buffer);
+        if (ret == 0) {
+            if (plan->kind == MERGE_PARTIAL || plan->kind == MERGE_FULL) {
+                metadata->merge_zones = 1;
+                pthread_mutex_unlock(&metadata->gc_mutex);
+                ret = merge_fill(metadata, plan, plan->start, metadata->n_blocks_per_zone, plan->dest + plan->start, buffer);
+                pthread_mutex_lock(&metadata->gc_mutex);
+                metadata->merge_zones = 0;
+            } else if (plan->kind == MERGE_CHUNK) {
+                pthread_mutex_unlock(&metadata->gc_mutex);
+                for (size_t i = 0; i < plan->dirty.size() && ret == 0; i++) {
+                    uint32_t start = plan->dirty[i].first * metadata->chunk_blocks;
+                    ret = merge_fill(metadata, plan, start, start + chunk_len(metadata, plan->dirty[i].first), plan->dirty[i].second, buffer);
+                }
+                pthread_mutex_lock(&metadata->gc_mutex);
+            }
+            ret = zone_merge_commit(metadata, plan, ret);
+            // trimmed as a whole while the blocks were copied
+            trim_release(metadata, plan->lzone);
+        }
+        free(buffer);
+        if (ret) {
+            printf("Error: GC failed, ret:%d\n", ret);
+        }
+        metadata->stats.gc_read_blocks += metadata->merge_io.gc_read_blocks;
+        metadata->stats.gc_write_blocks += metadata->merge_io.gc_write_blocks;
+        metadata->stats.gc_copy_blocks += metadata->merge_io.gc_copy_blocks;
+        metadata->stats.checksum_errors += metadata->merge_io.checksum_errors;
+        metadata->stats.gc_time_us += microseconds_since_epoch() - gc_start;
+        return metadata->merge_io.gc_read_blocks + metadata->merge_io.gc_write_blocks + metadata->merge_io.gc_copy_blocks;
+    }
+
+    /**
+    * GC age sorting
+    * A logical zone with only a few live blocks in the victim is not merged, a merge would rewrite the
+    * whole zone for them. Those blocks move along in the log instead, to the GC stream of their age: the
+    * number of passes they survived. Blocks that survive the last age bucket are merged into their data
+    * zone. A new GC zone is only opened while the log budget is not below the watermark, and a pass moves
+    * at most half a zone, so every pass still gives space back.
+    */
+    int64_t gc_relocate(struct zns_ftl *metadata, struct merge_plan *plan, uint32_t age) {
+        uint32_t nbz = metadata->n_blocks_per_zone, lsb = metadata->dev->lba_size_bytes;
+        int stream = LOG_STREAM_GC + age;
+        std::vector<std::pair<int64_t, int64_t>> moving;
+        for (auto &entry : plan->map) {
+            if (entry.second / nbz == metadata->gc_victim) {
+                moving.push_back(entry);
+            }
+        }
+        uint64_t room = 0;
+        int64_t head = metadata->log_stream_zone[stream];
+        if (head != -1) {
+            room = metadata->zones[head].slba + metadata->zones[head].cap - metadata->zones[head].wp;
+        }
+        if (moving.size() > room && log_zones_free(metadata) < (int64_t)metadata->gc_watermark) {
+            return -1;
+        }
+
+        // read the blocks in device order, then append them to the stream
+        std::sort(moving.begin(), moving.end(), [](const std::pair<int64_t, int64_t> &a, const std::pair<int64_t, int64_t> &b) { return a.second < b.second; });
+        char *buffer = (char *)malloc((uint64_t)moving.size() * lsb);
+        std::vector<struct ss_io_vec> vec;
+        std::vector<struct packed_io> packed;
+        for (size_t i = 0; i < moving.size(); i++) {
+            auto p = plan->packed.find(moving[i].first);
+            if (p != plan->packed.end()) {
+                packed.push_back({(uint64_t)moving[i].second, p->second, buffer + i * lsb});
+            } else {
+                vec.push_back({(uint64_t)moving[i].second, 1, buffer + i * lsb});
+            }
+        }
+        int ret = ss_io_readv(metadata->io_sched, SS_IO_GC, vec.data(), vec.size());
+        int64_t unpacked = ret ? 0 : packed_readv(metadata, SS_IO_GC, packed);
+        if (ret || unpacked < 0) {
+            printf("ERROR: failed to read blocks to relocate, ret: %d\n", ret);
+            free(buffer);
+            return -1;
+        }
+        metadata->stats.gc_read_blocks += vec.size() + unpacked;
+
+        int64_t zone_base = (plan->lzone - metadata->log_zone_num_config) * (int64_t)nbz * lsb;
+        if (metadata->checksum == ZNS_CHECKSUM_VERIFY) {
+            for (size_t i = 0; i < moving.size(); i++) {
+                uint64_t address = zone_base + moving[i].first * lsb;
+                metadata->stats.checksum_errors += blocks_verify(metadata, address, buffer + i * lsb, 1, &metadata->block_crcs[address / lsb]);
+            }
+        }
+        uint32_t done = 0;
+        while (done < moving.size()) {
+            int64_t *zone_no = &metadata->log_stream_zone[stream];
+            if (*zone_no == -1 || metadata->zones[*zone_no].state == FULL_ZONE) {
+                if (log_zones_free(metadata) < (int64_t)metadata->gc_watermark) {
+                    ret = -ENOSPC;
+                    break;
+                }
+                if (log_stream_open(metadata, stream) == -1) {
+                    ret = -ENOSPC;
+                    break;
+                }
+            }
+            struct zns_zone_info *zone = &metadata->zones[*zone_no];
+            uint64_t nlb = std::min<uint64_t>(moving.size() - done, zone->slba + zone->cap - zone->wp);
+            nlb = std::min<uint64_t>(nlb, metadata->mdts / lsb);
+            __u64 lba_result = 0;
+            ret = ss_io_append(metadata->io_sched, SS_IO_GC, zone->slba, nlb, buffer + (uint64_t)done * lsb, &lba_result);
+            if (ret) {
+                printf("ERROR: failed to relocate blocks, ret: %d\n", ret);
+                zone_mirror_reconcile(metadata);
+                break;
+            }
+            zone_mirror_append(metadata, lba_result, nlb);
+            // the blocks move unpacked, a shared block is copied for the mapping that moves
+            for (uint32_t i = 0; i < nlb; i++) {
+                uint64_t address = zone_base + moving[done + i].first * lsb;
+                auto ref = metadata->dedup_refs.find(log_phys(metadata, address, moving[done + i].second));
+                bool indexed = ref != metadata->dedup_refs.end();
+                uint64_t fp = indexed ? ref->second.fp : 0;
+                log_release(metadata, address, moving[done + i].second);
+                metadata->log_zone_mapping[address] = lba_result + i;
+                metadata->packed_blocks.erase(address);
+                if (indexed) {
+                    dedup_register(metadata, (lba_result + i) * lsb, fp, 0);
+                }
+            }
+            metadata->valid_blocks[*zone_no] += nlb;
+            metadata->stats.gc_write_blocks += nlb;
+            metadata->stats.gc_relocated_blocks += nlb;
+            done += nlb;
+        }
+        free(buffer);
+        metadata->gc_pass_relocated += done;
+        // what did not make it stays where it is, the merge takes it
+        return ret == 0 ? 2 * (int64_t)done : -1;
+    }
+
+    // merge the next logical zone of the pass, returns the blocks of device I/O it took
+    int64_t gc_merge_next(struct zns_ftl *metadata) {
+        struct merge_plan plan;
+        plan.lzone = metadata->gc_pending.front();
+        plan.wear = false;
+        metadata->gc_pending.pop_front();
+        merge_collect(metadata, &plan);
+        // overwritten since the pass started, nothing left to merge
+        if (plan.map.empty()) {
+            return 0;
+        }
+
+        uint32_t nbz = metadata->n_blocks_per_zone;
+        if (metadata->gc_age_buckets > 0 && metadata->gc_victim != -1 && metadata->zone_gc_age[metadata->gc_victim] < metadata->gc_age_buckets) {
+            uint32_t in_victim = 0;
+            for (auto &entry : plan.map) {
+                in_victim += (entry.second / nbz == metadata->gc_victim);
+            }
+            if (in_victim * 4 <= nbz && metadata->gc_pass_relocated + in_victim <= nbz / 2) {
+                uint64_t gc_start = microseconds_since_epoch();
+                int64_t cost = gc_relocate(metadata, &plan, metadata->zone_gc_age[metadata->gc_victim]);
+                metadata->stats.gc_time_us += microseconds_since_epoch() - gc_start;
+                if (cost >= 0) {
+                    return cost;
+                }
+                plan.map.clear();
+                plan.packed.clear();
+                merge_collect(metadata, &plan);
+            }
+        }
+        return merge_run(metadata, &plan);
+    }
+
+    /**
+    * Static wear leveling
+    * Allocation hands out the least worn free zone, but data that is never rewritten keeps its zone
+    * out of the rotation. Once the least worn data zone lags wear_gap resets behind the most worn
+    * zone, its data moves to the most worn free zone, and the young zone joins the pool.
+    * One migration at the end of a GC pass, when the log budget has a zone to spare.
+    */
+    void wear_level(struct zns_ftl *metadata) {
+        if (metadata->wear_gap == 0 || log_zones_free(metadata) <= (int64_t)metadata->gc_watermark) {
+            return;
+        }
+        uint32_t nbz = metadata->n_blocks_per_zone, max_resets = 0;
+        for (uint32_t i = 0; i < metadata->n_zones; i++) {
+            max_resets = std::max(max_resets, metadata->zone_resets[i]);
+        }
+        int64_t victim = -1;
+        uint32_t victim_resets = 0;
+        for (auto &entry : metadata->data_zone_mapping) {
+            uint32_t resets = metadata->zone_resets[entry.second / nbz];
+            if (victim == -1 || resets < victim_resets) {
+                victim = entry.first;
+                victim_resets = resets;
+            }
+        }
+        if (victim == -1 || max_resets - victim_resets < metadata->wear_gap) {
+            return;
+        }
+
+        pthread_mutex_lock(&metadata->reset_mutex);
+        if (metadata->free_zones.empty()) {
+            pthread_mutex_unlock(&metadata->reset_mutex);
+            return;
+        }
+        uint32_t dest = take_free_zone(metadata, true);
+        if (metadata->zone_resets[dest] <= victim_resets) {
+            metadata->free_zones.push_back(dest);
+            pthread_mutex_unlock(&metadata->reset_mutex);
+            return;
+        }
+        pthread_mutex_unlock(&metadata->reset_mutex);
+
+        struct merge_plan plan;
+        plan.lzone = victim;
+        plan.wear = true;
+        plan.dest = metadata->zones[dest].slba;
+        merge_collect(metadata, &plan);
+        merge_run(metadata, &plan);
+    }
+
+    // the chunk area is short of a zone of room: the live chunks of its emptiest zone move on, each with the
+    // log blocks of its logical zone, so that zone goes back to the pool. At the end of a GC pass, like wear
+    // leveling, and only when it pays (fewer live chunks than the zone has slots)
+    void chunk_area_clean(struct zns_ftl *metadata) {
+        if (metadata->chunk_zone_num_config == 0 || log_zones_free(metadata) <= (int64_t)metadata->gc_watermark) {
+            return;
+        }
+        chunk_area_sweep(metadata);
+        uint32_t nbz = metadata->n_blocks_per_zone, n_chunks = chunks_per_zone(metadata);
+        uint64_t slots = nbz / metadata->chunk_blocks, room = chunk_area_room(metadata);
+        int64_t victim = -1;
+        for (uint32_t zone_no : metadata->chunk_zone_list) {
+            if (zone_no != metadata->chunk_zone && (victim == -1 || metadata->valid_blocks[zone_no] < metadata->valid_blocks[victim])) {
+                victim = zone_no;
+            }
+        }
+        if (room >= slots || victim == -1) {
+            return;
+        }
+        std::unordered_map<int64_t, std::vector<uint32_t>> moving;
+        uint64_t count = 0;
+        for (auto &entry : metadata->chunk_mapping) {
+            if (entry.second / nbz == victim) {
+                moving[entry.first / n_chunks + metadata->log_zone_num_config].push_back(entry.first % n_chunks);
+                count++;
+            }
+        }
+        if (count >= slots || count > room) {
+            return;
+        }
+        for (auto &lzone : moving) {
+            struct merge_plan plan;
+            plan.lzone = lzone.first;
+            plan.wear = false;
+            plan.relocate = lzone.second;
+            merge_collect(metadata, &plan);
+            merge_run(metadata, &plan);
+            if (metadata->gc_stop) {
+                break;
+            }
+        }
+    }
+
+    void gc_end_pass(struct zns_ftl *metadata) {
+        int ret = 0;
+        // hand every log zone without live blocks left to a reset task, in one batch
+        std::vector<uint32_t> reclaimed;
+        for (auto it = metadata->log_zone_list.begin(); it != metadata->log_zone_list.end();) {
+            struct zns_zone_info *zone = &metadata->zones[*it];
+            if (metadata->valid_blocks[*it] == 0 && zone->wp != zone->slba) {
+                for (int s = 0; s < N_LOG_STREAMS; s++) {
+                    if (metadata->log_stream_zone[s] == *it) {
+                        metadata->log_stream_zone[s] = -1;
+                    }
+                }
+                reclaimed.push_back(*it);
+                it = metadata->log_zone_list.erase(it);
+            } else {
+                it++;
+            }
+        }
+        pthread_mutex_lock(&metadata->reset_mutex);
+        metadata->reset_queue.insert(metadata->reset_queue.end(), reclaimed.begin(), reclaimed.end());
+        reset_kick(metadata);
+        pthread_mutex_unlock(&metadata->reset_mutex);
+        metadata->stats.gc_runs++;
+        metadata->stats.gc_zones_reclaimed += reclaimed.size();
+        metadata->gc_pass_open = false;
+
+        if (metadata->zone_check) {
+            drain_zone_resets(metadata);
+            ret = zone_mirror_check(metadata);
+            if (ret) {
+                printf("Error: zone mirror check failed after GC, ret:%d\n", ret);
+            }
+        }
+    }
+
+    // let foreground commands that queued up on the gc_mutex during a merge go first
+    void gc_yield(struct zns_ftl *metadata) {
+        pthread_mutex_unlock(&metadata->gc_mutex);
+        uint64_t start = microseconds_since_epoch();
+        while (__atomic_load_n(&metadata->fg_waiting, __ATOMIC_ACQUIRE) > 0 && microseconds_since_epoch() - start < GC_IDLE_US) {
+            sched_yield();
+        }
+        pthread_mutex_lock(&metadata->gc_mutex);
+    }
+
+    static bool gc_wanted(struct zns_ftl *metadata) {
+        return metadata->trigger_my_gc || (!metadata->gc_writer_woken && gc_background_due(metadata));
+    }
+
+    // background GC also starts when the device goes idle, a delayed task looks again after a while
+    void gc_timer_task(void *args) {
+        struct zns_ftl *metadata = (struct zns_ftl *)args;
+        pthread_mutex_lock(&metadata->gc_mutex);
+        metadata->gc_timer = false;
+        gc_kick(metadata);
+        pthread_mutex_unlock(&metadata->gc_mutex);
+    }
+
+    // one round of GC: a blocked writer gets a whole pass flat out, otherwise GC goes as far as its tokens
+    // allow. The task queues itself again while there is more to do
+    void gc_task(void *args) {
+        struct zns_ftl *metadata = (struct zns_ftl *)args;
+        pthread_mutex_lock(&metadata->gc_mutex);
+        if (!metadata->gc_stop && gc_wanted(metadata)) {
+            bool urgent = metadata->trigger_my_gc;
+            if (!metadata->gc_pass_open) {
+                gc_begin_pass(metadata);
+            }
+            while (!metadata->gc_pending.empty()) {
+                if (!urgent && !gc_background_due(metadata)) {
+                    break;
+                }
+                int64_t cost = gc_merge_next(metadata);
+                metadata->gc_tokens -= cost;
+                gc_yield(metadata);
+                if (metadata->gc_stop) {
+                    break;
+                }
+                urgent |= metadata->trigger_my_gc;
+            }
+            bool pass_ended = metadata->gc_pending.empty();
+            if (pass_ended) {
+                gc_end_pass(metadata);
+            }
+
+            // every blocked writer looks again, one that is still short of zones triggers the next pass
+            if (metadata->trigger_my_gc && !metadata->gc_pass_open) {
+                metadata->trigger_my_gc = false;
+                metadata->gc_writer_woken = true;
+                pthread_cond_broadcast(&metadata->stop_gc);
+            }
+            // the waiting writer goes first, the migration lets go of the gc_mutex while it copies
+            if (pass_ended && !metadata->gc_stop) {
+                wear_level(metadata);
+            }
+            if (pass_ended && !metadata->gc_stop) {
+                chunk_area_clean(metadata);
+            }
+        }
+
+        if (!metadata->gc_stop && gc_wanted(metadata)) {
+            ss_executor_submit(bg_executor, gc_task, metadata);
+        } else {
+            metadata->gc_scheduled = false;
+            if (!metadata->gc_stop && metadata->gc_bw_pct != 0 && !metadata->gc_timer) {
+                metadata->gc_timer = true;
+                ss_executor_submit_after(bg_executor, gc_timer_task, metadata, GC_IDLE_US);
+            }
+        }
+        pthread_mutex_unlock(&metadata->gc_mutex);
+    }
+
+    int deinit_ss_zns_device(struct user_zns_device *my_dev) {
+        int ret = -ENOSYS;
+        if (zns_volume_is(my_dev)) {
+            return zns_volume_deinit(my_dev);
+        }
+
+        //struct zns_device_metadata *metadata = (struct zns_device_metadata *)my_dev->_private;
+        auto *metadata = ftl_of(my_dev);
+        // no GC task of this instance starts from here on, and none runs once the cancel returns
+        pthread_mutex_lock(&metadata->gc_mutex);
+        metadata->gc_stop = true;
+        pthread_mutex_unlock(&metadata->gc_mutex);
+        ss_executor_cancel(bg_executor, metadata);
+        // that took a queued reset task along, the runs closed below may still need a zone
+        pthread_mutex_lock(&metadata->reset_mutex);
+        metadata->reset_scheduled = false;
+        if (!metadata->reset_queue.empty()) {
+            reset_kick(metadata);
+        }
+        pthread_mutex_unlock(&metadata->reset_mutex);
+
+        // unfinished sequential runs are left to the log, so their blocks stay mapped
+        while (!metadata->seq_runs.empty()) {
+            seq_run_close(metadata, 0);
+        }
+
+        // what is still queued is reset here, so the device is left clean
+        pthread_mutex_lock(&metadata->reset_mutex);
+        metadata->reset_stop = true;
+        pthread_mutex_unlock(&metadata->reset_mutex);
+        ss_executor_cancel(bg_executor, metadata);
+        drain_zone_resets(metadata);
+        pthread_mutex_lock(&bg_executor_mutex);
+        if (--bg_executor_users == 0) {
+            ss_executor_free(bg_executor);
+            delete bg_executor;
+            bg_executor = nullptr;
+        }
+        pthread_mutex_unlock(&bg_executor_mutex);
+        ss_io_sched_free(metadata->io_sched);
+        delete metadata->io_sched;
+
+        if (metadata->zone_check) {
+            ret = zone_mirror_check(metadata);
+            if (ret) {
+                printf("[ERROR] ZONE MIRROR CHECK FAILED AT DEINIT: %d\n", ret);
+            }
+        }
+
+        pthread_mutex_destroy(&metadata->gc_mutex);
+        pthread_mutex_destroy(&metadata->reset_mutex);
+        pthread_cond_destroy(&metadata->zone_freed);
+        ret = close(metadata->fd);
+        
+        if (ret != 0) {
+            printf("[ERROR] FAILED TO CLOSE FILE DESC: %d\n", ret);
+            return ret;
+        }
+
+        free(metadata->zones);
+        free(metadata->valid_blocks);
+        free(metadata->zone_mtime);
+        free(metadata->zone_gc_age);
+#ifdef STOSYS_ZLIB
+        if (metadata->compress) {
+            deflateEnd(&metadata->block_deflater);
+        }
+#endif
+        // the maps wait for the next instance on the device
+        pthread_mutex_lock(&kept_maps_mutex);
+        kept_maps[metadata->name] = std::move(static_cast<struct zns_ftl_maps &>(*metadata));
+        pthread_mutex_unlock(&kept_maps_mutex);
+        delete metadata;
+        free(my_dev);
+        
+        return ret;
+    }
+
+    // undoes a partly done ftl_init, before the instance took kept maps or a share of the executor
+    static int ftl_init_fail(struct user_zns_device **my_dev, int ret) {
+        auto *metadata = ftl_of(*my_dev);
+        if (metadata->io_sched != nullptr) {
+            ss_io_sched_free(metadata->io_sched);
+            delete metadata->io_sched;
+        }
+#ifdef STOSYS_ZLIB
+        if (metadata->compress) {
+            deflateEnd(&metadata->block_deflater);
+        }
+#endif
+        free(metadata->zones);
+        free(metadata->valid_blocks);
+        free(metadata->zone_mtime);
+        free(metadata->zone_gc_age);
+        pthread_mutex_destroy(&metadata->gc_mutex);
+        pthread_mutex_destroy(&metadata->reset_mutex);
+        pthread_cond_destroy(&metadata->zone_freed);
+        close(metadata->fd);
+        delete metadata;
+        free(*my_dev);
+        *my_dev = nullptr;
+        return ret;
+    }
+
+    // one FTL instance on the zones of the device that belong to the shard, all of them for 1 shard
+    static int ftl_init(struct zdev_init_params *params, struct user_zns_device **my_dev, uint32_t shard, uint32_t n_shards) {
+        int ret = -ENOSYS;
+
+        int fd = nvme_open(params->name);
+        if (fd < 0) {
+            printf("[ERROR] FAILED TO OPEN FILE DESC: %d\n", fd);
+            return ret;
+        }
+
+        auto *metadata = new zns_ftl();
+        (*my_dev) = static_cast<struct user_zns_device *>(calloc(sizeof(struct user_zns_device), 1));
+        metadata->dev = *my_dev;
+        metadata->name = params->name;
+        if (n_shards > 1) {
+            metadata->name += "#" + std::to_string(shard) + "/" + std::to_string(n_shards);
+        }
+        
+        metadata->fd = fd;
+        metadata->gc_watermark = params->gc_wmark;
+        metadata->log_zone_num_config = params->log_zones;
+        metadata->zone_check = params->zone_check;
+        metadata->hot_cold = params->hot_cold;
+        metadata->copy_offload = params->copy_offload;
+        metadata->zero_detect = params->zero_detect;
+        metadata->compress = params->compress;
+        metadata->dedup = params->dedup;
+        if (metadata->compress) {
+#ifdef STOSYS_ZLIB
+            // a window of one block is all a block can use
+            memset(&metadata->block_deflater, 0, sizeof(metadata->block_deflater));
+            if (deflateInit2(&metadata->block_deflater, Z_BEST_SPEED, Z_DEFLATED, 12, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                printf("[ERROR] FAILED TO SET UP COMPRESSION, WRITING UNCOMPRESSED\n");
+                metadata->compress = false;
+            }
+#else
+            printf("[WARNING] BUILT WITHOUT ZLIB, WRITING UNCOMPRESSED\n");
+            metadata->compress = false;
+#endif
+        }
+        metadata->gc_bw_pct = std::min(params->gc_bw_pct, 100U);
+        metadata->gc_adaptive = params->gc_adaptive;
+        if (metadata->gc_adaptive && metadata->gc_bw_pct == 0) {
+            metadata->gc_bw_pct = GC_ADAPTIVE_BW_PCT;
+        }
+        metadata->ingest_at_us = microseconds_since_epoch();
+        metadata->write_nonblock = params->write_nonblock;
+        metadata->gc_policy = (params->gc_policy >= 0 && params->gc_policy < ZNS_GC_N_POLICIES) ? params->gc_policy : ZNS_GC_GREEDY;
+        (*my_dev)->_private = static_cast<struct zns_device_metadata *>(metadata);
+        
+        /**
+        * Device Identification Phase
+        * Mainly for collecting related attributes of the zns device
+        */
+
+        // Get namespace id
+        ret = nvme_get_nsid(fd, &metadata->nsid);
+        if (ret != 0) {
+            printf("[ERROR] FAILED TO GET NAMESPACE ID: %d\n", ret);
+            return ftl_init_fail(my_dev, ret);
+        }
+
+        // Get namespace metadata
+        struct nvme_id_ns ns{};
+        ret = nvme_identify_ns(fd, metadata->nsid, &ns);
+        if (ret != 0) {
+            printf("[ERROR] FAILED TO GET NAMESPACE METADATA: %d\n", ret);
+            return ftl_init_fail(my_dev, ret);
+        }
+
+        // Get zone report (for a single one)
+        struct nvme_zone_report single_zone_report{};
+        ret = nvme_zns_mgmt_recv(fd, metadata->nsid, 0, NVME_ZNS_ZRA_REPORT_ZONES, NVME_ZNS_ZRAS_REPORT_ALL, false, sizeof(single_zone_report), (void *)&single_zone_report);
+        if (ret != 0) {
+            printf("[ERROR] FAILED TO REPORT ZONE INFO: %d\n", ret);
+            return ftl_init_fail(my_dev, ret);
+        }
+
+        (*my_dev)->tparams.zns_num_zones = single_zone_report.nr_zones;
+        metadata->n_zones = single_zone_report.nr_zones;
+        metadata->zones = (struct zns_zone_info *)calloc(single_zone_report.nr_zones, sizeof(struct zns_zone_info));
+        // a shard keeps the zone tables of the whole device but only ever uses its own range of zones
+        metadata->shard_zone_start = (uint64_t)metadata->n_zones * shard / n_shards;
+        metadata->shard_zone_end = (uint64_t)metadata->n_zones * (shard + 1) / n_shards;
+        uint32_t shard_zones = metadata->shard_zone_end - metadata->shard_zone_start;
+        // the chunk area is set aside next to the log
+        uint32_t chunk_zones = params->chunk_blocks == 0 ? 0 : params->chunk_zones != 0 ? params->chunk_zones : params->log_zones;
+        if (shard_zones <= (uint32_t)params->log_zones + chunk_zones) {
+            printf("[ERROR] A SHARD OF %u ZONES HAS NO ROOM NEXT TO %d LOG ZONES AND %u CHUNK ZONES\n", shard_zones, params->log_zones, chunk_zones);
+            return ftl_init_fail(my_dev, -EINVAL);
+        }
+
+        // the other shards use the rest of the device, a shard leaves the reset of its zones to its reset tasks
+        if (params->force_reset && n_shards == 1)
+        {
+            ret = nvme_zns_mgmt_send(fd, metadata->nsid, 0, true, NVME_ZNS_ZSA_RESET, 0, NULL);
+            if (ret)
+            {
+                printf("ERROR: failed to reset all zones %d \n", ret);
+                return ftl_init_fail(my_dev, ret);
+            }
+
+            // metadata->data_zone_start = metadata->data_zone_end = params->log_zones * n_blocks_per_zone;
+            metadata->log_zone_start = metadata->log_zone_end = 0;
+        }
+
+        // GC moves blocks with NVMe Copy when the controller has it, within the namespace limits
+        if (metadata->copy_offload) {
+            struct nvme_id_ctrl ctrl{};
+            ret = nvme_identify_ctrl(fd, &ctrl);
+            if (ret != 0 || !(le16toh(ctrl.oncs) & ONCS_COPY) || ns.mssrl == 0) {
+                metadata->copy_offload = false;
+            } else {
+                metadata->copy_max_ranges = ns.msrc + 1;
+                metadata->copy_max_range_blocks = std::min<uint32_t>(le16toh(ns.mssrl), 1 << 16);
+                metadata->copy_max_blocks = le32toh(ns.mcl) ? le32toh(ns.mcl) : UINT32_MAX;
+            }
+        }
+
+        //metadata->mdts = get_mdts_size(metadata->fd);
+        metadata->mdts = MDTS;
+
+        // Get zone report (for all zones)
+        // After getting the one single_zone_report, we now know the number of zones
+        // This is the only full report, from here on the zone mirror is kept up to date by the FTL itself
+        ret = zone_mirror_load(metadata);
+        if (ret != 0) {
+            return ftl_init_fail(my_dev, ret);
+        }
+
+        /**
+        * Attributes & Data Population Phase
+        * Mainly for calculating and filling in corresponding attributes data
+        * to the metadata and related struct
+        */
+        (*my_dev)->lba_size_bytes = 1 << ns.lbaf[(ns.flbas & 0xf)].ds;
+        (*my_dev)->tparams.zns_lba_size = (*my_dev)->lba_size_bytes;
+        // (*my_dev)->tparams.zns_num_zones = single_zone_report.nr_zones;
+        uint64_t n_blocks_per_zone = metadata->zones[0].cap;
+        //metadata->n_blocks_per_zone = n_blocks_per_zone;
+        (*my_dev)->tparams.zns_zone_capacity = n_blocks_per_zone * (*my_dev)->lba_size_bytes;
+        // chunks of at least a zone are no chunks
+        if (params->chunk_blocks >= n_blocks_per_zone) {
+            printf("[WARNING] CHUNKS OF %u BLOCKS ARE NOT SMALLER THAN A ZONE, MAPPING WHOLE ZONES ONLY\n", params->chunk_blocks);
+            chunk_zones = 0;
+        }
+        metadata->chunk_blocks = chunk_zones != 0 ? params->chunk_blocks : 0;
+        metadata->chunk_zone_num_config = chunk_zones;
+        metadata->chunk_zone = -1;
+        (*my_dev)->capacity_bytes = (uint64_t)(shard_zones - params->log_zones - chunk_zones) * ((*my_dev)->tparams.zns_zone_capacity);
+
+        // For Milestone 2, GC watermark and two "pointers" chasing each other
+        // metadata->gc_watermark = params->gc_wmark;
+        metadata->log_zone_start = 0;
+        metadata->log_zone_end = 0;
+        metadata->data_zone_start = params->log_zones * n_blocks_per_zone;
+        metadata->data_zone_end = params->log_zones * n_blocks_per_zone;
+        metadata->n_blocks_per_zone = n_blocks_per_zone;
+        metadata->n_log_zone = params->log_zones;
+        metadata->valid_blocks = (uint32_t *)calloc(metadata->n_zones, sizeof(uint32_t));
+        metadata->zone_mtime = (uint64_t *)calloc(metadata->n_zones, sizeof(uint64_t));
+        metadata->zone_gc_age = (uint8_t *)calloc(metadata->n_zones, sizeof(uint8_t));
+        metadata->gc_age_buckets = std::min<uint32_t>(params->gc_age_buckets, GC_AGE_MAX);
+        metadata->wear_gap = params->wear_gap;
+
+        // from here on device commands go through the scheduler
+        int io_mode = (params->io_sched >= SS_IO_SCHED_OFF && params->io_sched <= SS_IO_SCHED_STRICT) ? params->io_sched : SS_IO_SCHED_OFF;
+        metadata->io_sched = new struct ss_io_sched();
+        ret = ss_io_sched_init(metadata->io_sched, fd, metadata->nsid, (*my_dev)->lba_size_bytes, MDTS, io_mode, params->io_weights, IO_SCHED_WORKERS);
+        if (ret) {
+            delete metadata->io_sched;
+            metadata->io_sched = nullptr;
+            return ftl_init_fail(my_dev, ret);
+        }
+        for (int s = 0; s < N_LOG_STREAMS; s++) {
+            metadata->log_stream_zone[s] = -1;
+        }
+
+        // temperature is kept per range, about a million ranges at most. A range's count halves
+        // every time the log's worth of blocks has been written
+        uint64_t user_blocks = (*my_dev)->capacity_bytes / (*my_dev)->lba_size_bytes;
+        metadata->heat_range_blocks = std::max<uint64_t>(16, user_blocks >> 20);
+        metadata->heat_epoch_blocks = std::max<uint64_t>(1, (uint64_t)(params->log_zones - params->gc_wmark) * n_blocks_per_zone);
+        if (metadata->hot_cold) {
+            metadata->heat_map.assign((user_blocks + metadata->heat_range_blocks - 1) / metadata->heat_range_blocks, {0, 0});
+        }
+
+        // GC and resets run as tasks on the executor all instances share, nothing fails after this
+        pthread_mutex_lock(&bg_executor_mutex);
+        if (bg_executor_users == 0) {
+            bg_executor = new struct ss_executor();
+            ret = ss_executor_init(bg_executor, params->bg_threads != 0 ? params->bg_threads : BG_THREADS);
+            if (ret) {
+                delete bg_executor;
+                bg_executor = nullptr;
+                pthread_mutex_unlock(&bg_executor_mutex);
+                return ftl_init_fail(my_dev, ret);
+            }
+        }
+        bg_executor_users++;
+        pthread_mutex_unlock(&bg_executor_mutex);
+
+        // a reset device has nothing mapped, otherwise the mappings of an earlier instance still own their zones
+        pthread_mutex_lock(&kept_maps_mutex);
+        auto kept = kept_maps.find(metadata->name);
+        if (kept != kept_maps.end()) {
+            if (params->force_reset) {
+                metadata->zone_resets = std::move(kept->second.zone_resets);
+            } else {
+                static_cast<struct zns_ftl_maps &>(*metadata) = std::move(kept->second);
+            }
+            kept_maps.erase(kept);
+        }
+        pthread_mutex_unlock(&kept_maps_mutex);
+        metadata->zone_resets.resize(metadata->n_zones, 0);
+        // chunks carry over in the size they were made in, even if this instance makes none
+        if (!metadata->chunk_mapping.empty() && metadata->chunk_map_blocks != metadata->chunk_blocks) {
+            printf("[WARNING] THE DATA ON THE DEVICE IS MAPPED IN CHUNKS OF %u BLOCKS, NOT %u\n", metadata->chunk_map_blocks, metadata->chunk_blocks);
+            metadata->chunk_blocks = metadata->chunk_map_blocks;
+        }
+        metadata->chunk_map_blocks = metadata->chunk_blocks;
+        // checksums carry over from an earlier instance that kept them, one that did not left them stale
+        metadata->checksum = (params->checksum > ZNS_CHECKSUM_OFF && params->checksum <= ZNS_CHECKSUM_VERIFY) ? params->checksum : ZNS_CHECKSUM_OFF;
+        if (params->force_reset || metadata->checksum == ZNS_CHECKSUM_OFF) {
+            metadata->block_crcs.clear();
+        }
+        if (metadata->checksum != ZNS_CHECKSUM_OFF) {
+            pthread_once(&crc32c_once, crc32c_setup);
+            std::vector<char> zeroes((*my_dev)->lba_size_bytes, 0);
+            metadata->zero_block_crc = block_crc(zeroes.data(), zeroes.size());
+            if (metadata->block_crcs.size() != user_blocks && metadata->log_zone_mapping.empty() && metadata->data_zone_mapping.empty()) {
+                metadata->block_crcs.assign(user_blocks, metadata->zero_block_crc);
+            } else if (metadata->block_crcs.size() != user_blocks) {
+                printf("[WARNING] NO CHECKSUMS FOR THE DATA ON THE DEVICE, RUNNING WITHOUT\n");
+                metadata->checksum = ZNS_CHECKSUM_OFF;
+                metadata->block_crcs.clear();
+            }
+        }
+        metadata->seq_run_blocks = std::max<uint32_t>(1, n_blocks_per_zone / 8);
+        metadata->gc_victim = -1;
+        metadata->gc_slack = std::max(1, (params->log_zones - params->gc_wmark) / 2);
+        std::vector<bool> in_use(metadata->n_zones, false);
+        for (auto &entry : metadata->data_zone_mapping) {
+            in_use[entry.second / n_blocks_per_zone] = true;
+        }
+        for (auto &entry : metadata->log_zone_mapping) {
+            uint32_t zone_no = entry.second / n_blocks_per_zone;
+            if (!in_use[zone_no]) {
+                in_use[zone_no] = true;
+                metadata->log_zone_list.push_back(zone_no);
+            }
+            metadata->valid_blocks[zone_no]++;
+        }
+        metadata->log_zone_end = metadata->log_zone_mapping.size();
+        for (auto &entry : metadata->chunk_mapping) {
+            uint32_t zone_no = entry.second / n_blocks_per_zone;
+            if (!in_use[zone_no]) {
+                in_use[zone_no] = true;
+                metadata->chunk_zone_list.push_back(zone_no);
+            }
+            metadata->valid_blocks[zone_no] += chunk_len(metadata, entry.first % chunks_per_zone(metadata));
+        }
+
+        // every other zone is free, what is not empty yet is reset by a reset task first
+        for (uint32_t i = metadata->shard_zone_start; i < metadata->shard_zone_end; i++) {
+            if (in_use[i]) {
+                continue;
+            }
+            if (metadata->zones[i].state == EMPTY_ZONE) {
+                metadata->free_zones.push_back(i);
+            } else if (metadata->zones[i].state != READ_ONLY_ZONE && metadata->zones[i].state != OFFLINE_ZONE) {
+                metadata->reset_queue.push_back(i);
+            }
+        }
+
+        pthread_mutex_lock(&metadata->reset_mutex);
+        if (!metadata->reset_queue.empty()) {
+            reset_kick(metadata);
+        }
+        pthread_mutex_unlock(&metadata->reset_mutex);
+        pthread_mutex_lock(&metadata->gc_mutex);
+        gc_kick(metadata);
+        pthread_mutex_unlock(&metadata->gc_mutex);
+
+        return 0;
+    }
+
+    int init_ss_zns_device(struct zdev_init_params *params, struct user_zns_device **my_dev) {
+        if (strchr(params->name, ',') != nullptr || params->shards > 1) {
+            return zns_volume_init(params, my_dev);
+        }
+        return ftl_init(params, my_dev, 0, 1);
+    }
+
+    int init_ss_zns_shard(struct zdev_init_params *params, struct user_zns_device **my_dev, uint32_t shard, uint32_t n_shards) {
+        return ftl_init(params, my_dev, shard, n_shards);
+    }
+
+    // read blocks wherever they are now, the caller holds the gc_mutex
+    int read_blocks(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size) {
+        if (size % my_dev->lba_size_bytes) {
+            printf("INVALID: read size not aligned to block size\n");
+            return -1;
+        }
+
+        int32_t ret, lba_s = my_dev->lba_size_bytes;
+        uint32_t blocks = size / lba_s, num_read = 0;
+        auto *metadata = ftl_of(my_dev);
+        uint64_t zone_bytes = (uint64_t)metadata->n_blocks_per_zone * metadata->dev->lba_size_bytes;
+        // blocks of one request can be scattered over the log and data zones, so they are looked up one by one
+        // and go down as one batch, where the scheduler merges what is adjacent on the device again
+        std::vector<struct ss_io_vec> vec;
+        std::vector<struct packed_io> packed;
+        vec.reserve(blocks);
+        for (uint64_t i = address; i < address + blocks * lba_s; i += lba_s) {
+            uint64_t entry;
+            bool read_data = true;
+            int64_t zone_number = (i / zone_bytes) + metadata->log_zone_num_config;
+            uint64_t offset = (i % zone_bytes) / metadata->dev->lba_size_bytes;
+            for (auto &run : metadata->seq_runs) {
+                if (run.lzone == zone_number && run.zone != -1 && offset < run.len) {
+                    entry = metadata->zones[run.zone].slba + offset;
+                    read_data = false;
+                }
+            }
+            if (read_data && (metadata->log_zone_mapping.find(i) != metadata->log_zone_mapping.end())) {
+                entry = metadata->log_zone_mapping[i];
+                read_data = false;
+                auto p = metadata->packed_blocks.find(i);
+                if (p != metadata->packed_blocks.end()) {
+                    packed.push_back({entry, p->second, (char *)buffer + num_read});
+                    num_read += lba_s;
+                    continue;
+                }
+            }
+
+            if (read_data) {
+                if (!(metadata->data_zone_mapping.find(zone_number) != metadata->data_zone_mapping.end()) || block_trimmed(metadata, zone_number, offset)) {
+                    // never written, trimmed or written as zeroes, reads back as zeroes
+                    memset((char *)buffer + num_read, 0, lba_s);
+                    num_read += lba_s;
+                    continue;
+                }
+
+                entry = metadata->data_zone_mapping[zone_number] + offset;
+                if (!metadata->chunk_mapping.empty()) {
+                    auto chunk = metadata->chunk_mapping.find(chunk_key(metadata, zone_number, offset / metadata->chunk_blocks));
+                    if (chunk != metadata->chunk_mapping.end()) {
+                        entry = chunk->second + offset % metadata->chunk_blocks;
+                    }
+                }
+            }
+
+            vec.push_back({entry, 1, (char *)buffer + num_read});
+            num_read += lba_s;
+        }
+
+        ret = ss_io_readv(metadata->io_sched, SS_IO_USER_READ, vec.data(), vec.size());
+        if (ret) {
+            printf("ERROR: failed to read at 0x%lx, ret: %d\n", address, ret);
+            return ret;
+        }
+        int64_t unpacked = packed_readv(metadata, SS_IO_USER_READ, packed);
+        if (unpacked < 0) {
+            return unpacked;
+        }
+        if (metadata->checksum == ZNS_CHECKSUM_VERIFY) {
+            uint32_t bad = blocks_verify(metadata, address, (char *)buffer, blocks, &metadata->block_crcs[address / lba_s]);
+            if (bad > 0) {
+                metadata->stats.checksum_errors += bad;
+                return -EIO;
+            }
+        }
+        return 0;
+    }
+
+    // foreground commands take the gc_mutex, GC lets them in between its merges
+    void fg_lock(struct zns_ftl *metadata) {
+        __atomic_add_fetch(&metadata->fg_waiting, 1, __ATOMIC_ACQ_REL);
+        pthread_mutex_lock(&metadata->gc_mutex);
+        __atomic_sub_fetch(&metadata->fg_waiting, 1, __ATOMIC_ACQ_REL);
+    }
+
+    int zns_udevice_read(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size) {
+        if (zns_volume_is(my_dev)) {
+            return zns_volume_read(my_dev, address, buffer, size);
+        }
+        if (address % my_dev->lba_size_bytes) {
+            printf("INVALID: read address not aligned to block size\n");
+            return -EINVAL;
+        }
+        // the maps and block CRCs only cover the capacity
+        if (address + size > my_dev->capacity_bytes) {
+            printf("INVALID: read of %u bytes at 0x%lx is beyond the device capacity\n", size, address);
+            return -EINVAL;
+        }
+        auto *metadata = ftl_of(my_dev);
+        fg_lock(metadata);
+        int ret = read_blocks(my_dev, address, buffer, size);
+        gc_credit(metadata, size / my_dev->lba_size_bytes);
+        pthread_mutex_unlock(&metadata->gc_mutex);
+        return ret;
+    }
+
+    // append blocks to the log, the caller holds the gc_mutex. With dedup, fps has the fingerprints of the blocks
+    int log_write(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t blocks, int hint, const uint64_t *fps) {
+        auto *metadata = ftl_of(my_dev);
+        // split the request into runs per log stream, a range is classified once per request
+        std::vector<struct stream_run> runs;
+        uint64_t first_lba = address / my_dev->lba_size_bytes;
+        for (uint32_t i = 0; i < blocks;) {
+            uint64_t lba = first_lba + i;
+            uint32_t len = std::min<uint64_t>(blocks - i, metadata->heat_range_blocks - lba % metadata->heat_range_blocks);
+            int stream = LOG_STREAM_COLD;
+            if (hint != ZNS_HINT_NONE) {
+                // the user knows better than the heat map
+                stream = LOG_STREAM_HINT + hint - 1;
+            } else if (metadata->hot_cold && heat_touch(metadata, lba)) {
+                stream = LOG_STREAM_HOT;
+            }
+            if (!runs.empty() && runs.back().stream == stream) {
+                runs.back().blocks += len;
+            } else {
+                runs.push_back({i, len, stream});
+            }
+            i += len;
+        }
+        if (metadata->hot_cold) {
+            heat_advance(metadata, blocks);
+        }
+
+        // a zone a background merge holds comes back when it commits. A pass that gave a zone back made
+        // progress, even when a GC stream already took it again
+        if (metadata->write_nonblock) {
+            // nobody waits for the pass GC runs for a write turned away, the write that comes back takes the room
+            bool pass_done = metadata->gc_writer_woken;
+            metadata->gc_writer_woken = false;
+            if (free_zone_number(metadata, runs) < metadata->gc_watermark && !metadata->log_zone_list.empty()) {
+                int64_t free_now = free_zone_number(metadata, runs) + metadata->merge_zones;
+                // once GC could not give anything back, the write goes ahead as a blocking one would
+                if (!pass_done || free_now > metadata->backoff_free || metadata->stats.gc_zones_reclaimed != metadata->backoff_reclaimed) {
+                    metadata->backoff_free = free_now;
+                    metadata->backoff_reclaimed = metadata->stats.gc_zones_reclaimed;
+                    metadata->trigger_my_gc = true;
+                    gc_kick(metadata);
+                    metadata->stats.write_backoffs++;
+                    return -EAGAIN;
+                }
+            }
+        }
+        // GC runs when the write would leave fewer than gc_wmark log zones free. A partly written zone is not
+        // free, so this is the first version's "free zones <= gc_wmark" with the open zone counted as free,
+        // except that a write ending on a zone boundary no longer triggers GC
+        while (!metadata->write_nonblock && free_zone_number(metadata, runs) < metadata->gc_watermark && !metadata->log_zone_list.empty()) {
+            int64_t free_before = free_zone_number(metadata, runs) + metadata->merge_zones;
+            uint64_t reclaimed_before = metadata->stats.gc_zones_reclaimed;
+            metadata->trigger_my_gc = true;
+            gc_kick(metadata);
+            pthread_cond_wait(&metadata->stop_gc, &metadata->gc_mutex);
+            metadata->gc_writer_woken = false;
+            if (free_zone_number(metadata, runs) + metadata->merge_zones <= free_before && metadata->stats.gc_zones_reclaimed == reclaimed_before) {
+                // GC could not give anything back, do not spin on it
+                break;
+            }
+        }
+
+        int32_t ret = 0;
+        uint32_t lsb = my_dev->lba_size_bytes;
+        std::vector<char> packs, pack;
+        std::vector<uint32_t> packed_len;
+        for (auto &run : runs) {
+            uint32_t written = 0;
+            // a single block packed still takes a whole LBA
+            bool compress = metadata->compress && run.blocks > 1;
+            if (compress) {
+                packs.resize((uint64_t)run.blocks * lsb);
+                pack.resize(metadata->mdts);
+                packed_len.resize(run.blocks);
+                for (uint32_t i = 0; i < run.blocks; i++) {
+                    packed_len[i] = block_compress(metadata, (char *)buffer + (uint64_t)(run.start + i) * lsb, lsb, packs.data() + (uint64_t)i * lsb);
+                }
+            }
+            while (written < run.blocks) {
+                // open a new log zone for the stream from the pre-erased pool when it has none or its zone is full
+                int64_t *head = &metadata->log_stream_zone[run.stream];
+                if (*head == -1 || metadata->zones[*head].state == FULL_ZONE) {
+                    if (log_stream_open(metadata, run.stream) == -1) {
+                        printf("[ERROR] NO FREE ZONE LEFT FOR THE LOG\n");
+                        ret = -ENOSPC;
+                        break;
+                    }
+                }
+
+                // the mirror tells how much room is left, so an append never crosses the zone end or the MDTS
+                struct zns_zone_info *zone = &metadata->zones[*head];
+                uint64_t nlb = std::min<uint64_t>(run.blocks - written, zone->slba + zone->cap - zone->wp);
+                nlb = std::min<uint64_t>(nlb, metadata->mdts / lsb);
+                uint64_t offset = (run.start + written) * (uint64_t)lsb;
+                char *data = (char *)buffer + offset;
+                // the blocks of the append, nlb LBAs unless packed
+                uint32_t n = nlb;
+                uint64_t packed_bytes = 0;
+                if (compress) {
+                    for (n = 0; written + n < run.blocks && packed_bytes + packed_len[written + n] <= nlb * lsb; n++) {
+                        memcpy(pack.data() + packed_bytes, packs.data() + (uint64_t)(written + n) * lsb, packed_len[written + n]);
+                        packed_bytes += packed_len[written + n];
+                    }
+                    if ((packed_bytes + lsb - 1) / lsb < n) {
+                        nlb = (packed_bytes + lsb - 1) / lsb;
+                        memset(pack.data() + packed_bytes, 0, nlb * lsb - packed_bytes);
+                        data = pack.data();
+                    } else {
+                        // packing saves nothing here, the blocks go as they are
+                        n = nlb;
+                        packed_bytes = 0;
+                    }
+                }
+                __u64 lba_result = 0;
+                ret = ss_io_append(metadata->io_sched, SS_IO_USER_WRITE, zone->slba, nlb, data, &lba_result);
+                if (ret != 0) {
+                    printf("[ERROR] FAILED TO WRITE TO DEVICE: %d\n", ret);
+                    zone_mirror_reconcile(metadata);
+                    break;
+                }
+                zone_mirror_append(metadata, lba_result, nlb);
+
+                uint64_t at = 0;
+                for (uint32_t i = 0; i < n; i++) {
+                    uint64_t lba = packed_bytes ? lba_result + at / lsb : lba_result + i;
+                    uint64_t block_address = address + offset + (uint64_t)i * lsb;
+                    auto entry = metadata->log_zone_mapping.find(block_address);
+                    if (entry != metadata->log_zone_mapping.end()) {
+                        // overwritten, the old copy is dead
+                        log_release(metadata, block_address, entry->second);
+                        entry->second = lba;
+                    } else {
+                        metadata->log_zone_mapping[block_address] = lba;
+                        metadata->log_zone_end++;
+                    }
+                    uint32_t len = 0;
+                    if (packed_bytes) {
+                        len = packed_len[written + i];
+                        metadata->packed_blocks[block_address] = {(uint32_t)(at % lsb), len};
+                        at += len;
+                    } else if (!metadata->packed_blocks.empty()) {
+                        metadata->packed_blocks.erase(block_address);
+                    }
+                    if (fps != nullptr) {
+                        dedup_register(metadata, log_phys(metadata, block_address, lba), fps[run.start + written + i], len);
+                    }
+                }
+                metadata->valid_blocks[*head] += n;
+                metadata->zone_mtime[*head] = write_clock(metadata);
+                metadata->stats.log_write_blocks += nlb;
+                if (packed_bytes) {
+                    metadata->stats.compress_blocks += n;
+                    metadata->stats.compress_saved_blocks += n - nlb;
+                }
+                if (run.stream == LOG_STREAM_HOT) {
+                    metadata->stats.hot_write_blocks += n;
+                } else {
+                    metadata->stats.cold_write_blocks += n;
+                }
+                written += n;
+            }
+            if (ret != 0) {
+                break;
+            }
+        }
+        return ret;
+    }
+
+    // write blocks at the end of a run zone, they replace whatever the log held for them
+    int seq_run_append(struct user_zns_device *my_dev, struct seq_run *run, void *buffer, uint32_t blocks) {
+        auto *metadata = ftl_of(my_dev);
+        struct zns_zone_info *zone = &metadata->zones[run->zone];
+        uint64_t wp = zone->wp;
+        int ret = io_with_mdts(metadata, SS_IO_USER_WRITE, wp, buffer, (uint64_t)blocks * my_dev->lba_size_bytes, false);
+        if (ret != 0) {
+            printf("[ERROR] FAILED TO WRITE SEQUENTIAL RUN AT 0x%lx: %d\n", wp, ret);
+            zone_mirror_refresh(metadata, run->zone);
+            return ret;
+        }
+        zone_mirror_append(metadata, wp, blocks);
+
+        uint64_t zone_bytes = (uint64_t)metadata->n_blocks_per_zone * my_dev->lba_size_bytes;
+        uint64_t base = (run->lzone - metadata->log_zone_num_config) * zone_bytes;
+        for (uint32_t i = 0; i < blocks; i++) {
+            log_invalidate(metadata, base + (uint64_t)(run->len + i) * my_dev->lba_size_bytes);
+        }
+        run->len += blocks;
+        metadata->stats.direct_write_blocks += blocks;
+        return 0;
+    }
+
+    // give a candidate its own zone, the part of the run that went to the log so far is copied over
+    int seq_run_promote(struct user_zns_device *my_dev, struct seq_run *run) {
+        auto *metadata = ftl_of(my_dev);
+        int64_t slba = next_empty_zone(metadata);
+        if (slba == -1) {
+            return -ENOSPC;
+        }
+        run->zone = slba / metadata->n_blocks_per_zone;
+        uint32_t prefix = run->len;
+        run->len = 0;
+        if (prefix == 0) {
+            return 0;
+        }
+
+        uint64_t zone_bytes = (uint64_t)metadata->n_blocks_per_zone * my_dev->lba_size_bytes;
+        char *buf = (char *)malloc((uint64_t)prefix * my_dev->lba_size_bytes);
+        int ret = read_blocks(my_dev, (run->lzone - metadata->log_zone_num_config) * zone_bytes, buf, prefix * my_dev->lba_size_bytes);
+        if (ret == 0) {
+            ret = seq_run_append(my_dev, run, buf, prefix);
+        }
+        free(buf);
+        return ret;
+    }
+
+    // the run covers the whole logical zone, its zone replaces the data zone
+    void seq_run_install(struct zns_ftl *metadata, size_t idx) {
+        struct seq_run run = metadata->seq_runs[idx];
+        metadata->seq_runs.erase(metadata->seq_runs.begin() + idx);
+        auto old = metadata->data_zone_mapping.find(run.lzone);
+        if (old != metadata->data_zone_mapping.end()) {
+            queue_zone_reset(metadata, old->second / metadata->n_blocks_per_zone);
+        }
+        metadata->data_zone_mapping[run.lzone] = metadata->zones[run.zone].slba;
+        chunk_drop(metadata, run.lzone);
+    }
+
+    // write the part of a request that falls into one logical zone, the caller holds the gc_mutex
+    int zone_segment_write(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t blocks, int hint, const uint64_t *fps) {
+        auto *metadata = ftl_of(my_dev);
+        uint64_t zone_bytes = (uint64_t)metadata->n_blocks_per_zone * my_dev->lba_size_bytes;
+        int64_t lzone = address / zone_bytes + metadata->log_zone_num_config;
+        uint32_t offset = (address % zone_bytes) / my_dev->lba_size_bytes;
+
+        size_t idx = metadata->seq_runs.size();
+        for (size_t i = 0; i < metadata->seq_runs.size(); i++) {
+            if (metadata->seq_runs[i].lzone == lzone) {
+                idx = i;
+            }
+        }
+        if (idx < metadata->seq_runs.size() && metadata->seq_runs[idx].len != offset) {
+            seq_run_close(metadata, idx);
+            idx = metadata->seq_runs.size();
+        }
+        if (idx == metadata->seq_runs.size() && offset == 0) {
+            if (metadata->seq_runs.size() == SEQ_RUN_SLOTS) {
+                seq_run_close(metadata, 0);
+            }
+            metadata->seq_runs.push_back({lzone, 0, -1});
+            idx = metadata->seq_runs.size() - 1;
+        }
+        if (idx == metadata->seq_runs.size()) {
+            return log_write(my_dev, address, buffer, blocks, hint, fps);
+        }
+
+        // a long enough run goes around the log, if the log budget has a zone to spare for it
+        struct seq_run *run = &metadata->seq_runs[idx];
+        if (run->zone == -1 && run->len + blocks >= metadata->seq_run_blocks &&
+            log_zones_free(metadata) - 1 >= (int64_t)metadata->gc_watermark) {
+            int ret = seq_run_promote(my_dev, run);
+            if (ret == -ENOSPC) {
+                run->zone = -1;
+            } else if (ret != 0) {
+                return ret;
+            }
+        }
+        if (run->zone == -1) {
+            int ret = log_write(my_dev, address, buffer, blocks, hint, fps);
+            // a write turned away is not part of the run yet
+            if (ret != -EAGAIN) {
+                run->len += blocks;
+            }
+            return ret;
+        }
+
+        int ret = seq_run_append(my_dev, run, buffer, blocks);
+        if (ret != 0) {
+            seq_run_close(metadata, idx);
+            return ret;
+        }
+        if (run->len == metadata->n_blocks_per_zone) {
+            seq_run_install(metadata, idx);
+        }
+        return 0;
+    }
+
+    int zns_udevice_write(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size)  {
+        return zns_udevice_write_hint(my_dev, address, buffer, size, ZNS_HINT_NONE);
+    }
+
+    // the log blocks the blocks of a write are the same as, -1 where there is none. The index is looked up under
+    // a short hold of the gc_mutex, the candidates are read and compared without it: block_dedup checks under
+    // the gc_mutex that they did not change since. Returns the fingerprint collisions found
+    uint32_t dedup_lookup(struct zns_ftl *metadata, const char *buffer, uint32_t blocks, const std::vector<uint64_t> &fps,
+                          std::vector<int64_t> &dups, std::unordered_map<int64_t, struct dedup_seen> &seen) {
+        uint32_t lsb = metadata->dev->lba_size_bytes;
+        dups.assign(blocks, -1);
+        fg_lock(metadata);
+        for (uint32_t i = 0; i < blocks; i++) {
+            int64_t phys = dedup_candidate(metadata, fps[i]);
+            auto ref = phys == -1 ? metadata->dedup_refs.end() : metadata->dedup_refs.find(phys);
+            if (ref != metadata->dedup_refs.end()) {
+                dups[i] = phys;
+                seen[phys] = {ref->second, __atomic_load_n(&metadata->zone_resets[phys / lsb / metadata->n_blocks_per_zone], __ATOMIC_RELAXED)};
+            }
+        }
+        pthread_mutex_unlock(&metadata->gc_mutex);
+        if (seen.empty()) {
+            return 0;
+        }
+
+        // each candidate is read once, plain and packed ones in a batch each
+        std::vector<char> copies(seen.size() * lsb);
+        std::unordered_map<int64_t, char *> copy;
+        std::vector<struct ss_io_vec> vec;
+        std::vector<struct packed_io> packed;
+        for (auto &s : seen) {
+            char *dest = copies.data() + copy.size() * lsb;
+            copy[s.first] = dest;
+            if (s.second.ref.len) {
+                packed.push_back({(uint64_t)s.first / lsb, {(uint32_t)(s.first % lsb), s.second.ref.len}, dest});
+            } else {
+                vec.push_back({(uint64_t)s.first / lsb, 1, dest});
+            }
+        }
+        if (ss_io_readv(metadata->io_sched, SS_IO_USER_WRITE, vec.data(), vec.size()) != 0 ||
+            packed_readv(metadata, SS_IO_USER_WRITE, packed) < 0) {
+            // the blocks are written as they are
+            dups.assign(blocks, -1);
+            return 0;
+        }
+        uint32_t collisions = 0;
+        for (uint32_t i = 0; i < blocks; i++) {
+            if (dups[i] != -1 && memcmp(copy[dups[i]], buffer + (uint64_t)i * lsb, lsb) != 0) {
+                dups[i] = -1;
+                collisions++;
+            }
+        }
+        return collisions;
+    }
+
+    int zns_udevice_write_hint(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size, int hint) {
+        if (hint < ZNS_HINT_NONE || hint >= ZNS_N_HINTS) {
+            printf("INVALID: unknown write hint %d\n", hint);
+            return -EINVAL;
+        }
+        if (zns_volume_is(my_dev)) {
+            return zns_volume_write(my_dev, address, buffer, size, hint);
+        }
+        if (size % my_dev->lba_size_bytes) {
+            printf("INVALID: write size not aligned to block size\n");
+            return -1;
+        }
+        if (address + size > my_dev->capacity_bytes) {
+            printf("INVALID: write of %u bytes at 0x%lx is beyond the device capacity\n", size, address);
+            return -EINVAL;
+        }
+
+        auto *metadata = ftl_of(my_dev);
+        uint32_t blocks = size / my_dev->lba_size_bytes;
+        // a write larger than the log could never be made room for. It may take all the log above the watermark:
+        // the last of its zones filled to the end leaves gc_wmark zones free (the first version refused that)
+        if (blocks > (metadata->log_zone_num_config - metadata->gc_watermark) * metadata->n_blocks_per_zone) {
+            printf("INVALID: write of %u bytes does not fit in the log\n", size);
+            return -EINVAL;
+        }
+
+        // Starting lock here
+        uint32_t lsb = my_dev->lba_size_bytes;
+        // zero blocks, fingerprints and checksums are found before the gc_mutex
+        std::vector<bool> zero;
+        if (metadata->zero_detect) {
+            zero.resize(blocks);
+            for (uint32_t i = 0; i < blocks; i++) {
+                zero[i] = block_is_zero((char *)buffer + (uint64_t)i * lsb, lsb);
+            }
+        }
+        auto is_zero = [&](uint32_t i) { return !zero.empty() && zero[i]; };
+        std::vector<uint64_t> fps;
+        std::vector<int64_t> dups;
+        std::unordered_map<int64_t, struct dedup_seen> seen;
+        uint32_t collisions = 0;
+        if (metadata->dedup) {
+            fps.resize(blocks);
+            for (uint32_t i = 0; i < blocks; i++) {
+                fps[i] = block_fingerprint((char *)buffer + (uint64_t)i * lsb, lsb);
+            }
+            collisions = dedup_lookup(metadata, (char *)buffer, blocks, fps, dups, seen);
+        }
+        std::vector<uint32_t> crcs;
+        if (metadata->checksum != ZNS_CHECKSUM_OFF) {
+            crcs.resize(blocks);
+            for (uint32_t i = 0; i < blocks; i++) {
+                crcs[i] = block_crc((char *)buffer + (uint64_t)i * lsb, lsb);
+            }
+        }
+        fg_lock(metadata);
+        metadata->stats.dedup_collisions += collisions;
+        int32_t ret = 0;
+        uint32_t written = 0;
+        uint64_t zone_bytes = (uint64_t)metadata->n_blocks_per_zone * lsb;
+        // the checksums go in with the mappings: a segment write may wait for GC before it maps anything. Those of
+        // a segment that fails stay as they were, what of it did reach the device reads back as a torn write
+        auto keep_crcs = [&](uint32_t n) {
+            if (!crcs.empty()) {
+                std::copy(crcs.begin() + written, crcs.begin() + written + n, metadata->block_crcs.begin() + address / lsb + written);
+            }
+        };
+        while (written < blocks) {
+            uint64_t at = address + (uint64_t)written * lsb;
+            char *data = (char *)buffer + (uint64_t)written * lsb;
+            uint32_t in_zone = metadata->n_blocks_per_zone - (at / lsb) % metadata->n_blocks_per_zone;
+            uint32_t n = std::min(blocks - written, in_zone);
+            // with zero_detect, all-zero blocks only go to the map, unless they carry on a sequential run, which costs no GC
+            if (!seq_run_continues(metadata, at / zone_bytes + metadata->log_zone_num_config, (at % zone_bytes) / lsb)) {
+                uint32_t zeros = 0;
+                while (zeros < n && is_zero(written + zeros)) {
+                    zeros++;
+                }
+                if (zeros > 0) {
+                    blocks_zeroed(metadata, at, zeros);
+                    metadata->stats.zero_write_blocks += zeros;
+                    written += zeros;
+                    continue;
+                }
+                // so are blocks the log already has
+                uint32_t shared = 0;
+                while (metadata->dedup && shared < n && block_dedup(metadata, at + (uint64_t)shared * lsb, dups[written + shared], fps[written + shared], seen)) {
+                    shared++;
+                }
+                if (shared > 0) {
+                    keep_crcs(shared);
+                    trim_forget(metadata, at, shared);
+                    metadata->stats.dedup_write_blocks += shared;
+                    written += shared;
+                    continue;
+                }
+                // the data goes down up to the next zero block, or the next block the log may have
+                uint32_t k = 1;
+                while (k < n && !is_zero(written + k) &&
+                       !(metadata->dedup && dups[written + k] != -1)) {
+                    k++;
+                }
+                n = k;
+            }
+            ret = zone_segment_write(my_dev, at, data, n, hint, metadata->dedup ? fps.data() + written : nullptr);
+            if (ret != 0) {
+                break;
+            }
+            keep_crcs(n);
+            trim_forget(metadata, at, n);
+            written += n;
+        }
+        // a write turned away comes back, only what it wrote so far counts now
+        uint32_t counted = ret == -EAGAIN ? written : blocks;
+        metadata->stats.user_write_blocks += counted;
+        if (hint != ZNS_HINT_NONE) {
+            metadata->stats.hint_write_blocks += counted;
+        }
+        gc_credit(metadata, counted);
+
+        pthread_mutex_unlock(&metadata->gc_mutex);
+        return ret;
+    }
+
+    // the user no longer needs a range: its log blocks are dead, its data blocks read back as zeroes and
+    // merges stop copying them, and a logical zone trimmed as a whole gives its data zone back
+    int zns_udevice_trim(struct user_zns_device *my_dev, uint64_t address, uint64_t size) {
+        if (zns_volume_is(my_dev)) {
+            return zns_volume_trim(my_dev, address, size);
+        }
+        if (address % my_dev->lba_size_bytes || size % my_dev->lba_size_bytes) {
+            printf("INVALID: trim not aligned to block size\n");
+            return -EINVAL;
+        }
+        if (address + size > my_dev->capacity_bytes) {
+            printf("INVALID: trim of %lu bytes at 0x%lx is beyond the device capacity\n", size, address);
+            return -EINVAL;
+        }
+
+        auto *metadata = ftl_of(my_dev);
+        fg_lock(metadata);
+        blocks_zeroed(metadata, address, size / my_dev->lba_size_bytes);
+        metadata->stats.trim_blocks += size / my_dev->lba_size_bytes;
+        pthread_mutex_unlock(&metadata->gc_mutex);
+        return 0;
+    }
+
+    int zns_udevice_get_stats(struct user_zns_device *my_dev, struct zns_udevice_stats *stats) {
+        if (zns_volume_is(my_dev)) {
+            return zns_volume_get_stats(my_dev, stats);
+        }
+        auto *metadata = ftl_of(my_dev);
+        pthread_mutex_lock(&metadata->gc_mutex);
+        *stats = metadata->stats;
+        pthread_mutex_unlock(&metadata->gc_mutex);
+        stats->wear_min_resets = UINT32_MAX;
+        stats->wear_max_resets = 0;
+        for (uint32_t i = metadata->shard_zone_start; i < metadata->shard_zone_end; i++) {
+            uint32_t resets = __atomic_load_n(&metadata->zone_resets[i], __ATOMIC_RELAXED);
+            stats->wear_min_resets = std::min(stats->wear_min_resets, resets);
+            stats->wear_max_resets = std::max(stats->wear_max_resets, resets);
+        }
+        return 0;
+    }
+
+    int zns_udevice_get_space(struct user_zns_device *my_dev, struct zns_udevice_space *space) {
+        if (zns_volume_is(my_dev)) {
+            return zns_volume_get_space(my_dev, space);
+        }
+        auto *metadata = ftl_of(my_dev);
+        pthread_mutex_lock(&metadata->gc_mutex);
+        int64_t free_zones = std::max<int64_t>(0, log_zones_free(metadata));
+        space->log_zones = metadata->log_zone_num_config;
+        space->free_log_zones = free_zones;
+        space->gc_watermark = metadata->gc_watermark;
+        // at the rate the log fills lately, the zones above the watermark last this long
+        ingest_sample(metadata);
+        space->ingest_blocks_per_s = metadata->ingest_rate * 1000000;
+        int64_t room_blocks = (free_zones - (int64_t)metadata->gc_watermark) * metadata->n_blocks_per_zone;
+        double last_us = metadata->ingest_rate > 0 ? room_blocks / metadata->ingest_rate : (double)UINT64_MAX;
+        space->exhaustion_us = room_blocks <= 0 ? 0 : last_us >= (double)UINT64_MAX ? UINT64_MAX : (uint64_t)last_us;
+        // GC is pressed for room within gc_slack of the watermark, every zone short of that costs what
+        // a reclaimed zone cost GC so far (a zone of copies before the first pass)
+        int64_t short_zones = metadata->gc_watermark + gc_slack_zones(metadata) - free_zones;
+        uint64_t reclaimed = metadata->stats.gc_zones_reclaimed;
+        space->gc_debt_blocks = short_zones <= 0 ? 0 : reclaimed == 0 ? short_zones * metadata->n_blocks_per_zone :
+                                short_zones * metadata->stats.gc_write_blocks / reclaimed;
+        // a write that needs a new zone waits at the watermark until a pass gives zones back: the merges
+        // left in the pass under way, or as many as a pass took so far, at what a merge took so far. Merges
+        // differ a lot, a writer comes back after half of that (one merge at least) and asks again
+        space->retry_after_us = 0;
+        if (free_zones <= (int64_t)metadata->gc_watermark) {
+            uint64_t merges = metadata->stats.full_merges + metadata->stats.partial_merges + metadata->stats.switch_merges;
+            uint64_t merge_us = merges == 0 ? GC_IDLE_US : std::max<uint64_t>(1, metadata->stats.gc_time_us / merges);
+            uint64_t left = metadata->gc_pass_open ? metadata->gc_pending.size() + 1 :
+                            std::max<uint64_t>(1, merges / std::max<uint64_t>(1, metadata->stats.gc_runs));
+            space->retry_after_us = std::max<uint64_t>(merge_us, left * merge_us / 2);
+        }
+        pthread_mutex_unlock(&metadata->gc_mutex);
+        return 0;
+    }
+
+    int zns_udevice_get_wear(struct user_zns_device *my_dev, uint32_t *resets, uint32_t n_zones) {
+        if (zns_volume_is(my_dev)) {
+            return zns_volume_get_wear(my_dev, resets, n_zones);
+        }
+        auto *metadata = ftl_of(my_dev);
+        if (n_zones < metadata->n_zones) {
+            return -EINVAL;
+        }
+        for (uint32_t i = 0; i < metadata->n_zones; i++) {
+            resets[i] = __atomic_load_n(&metadata->zone_resets[i], __ATOMIC_RELAXED);
+        }
+        return metadata->n_zones;
     }
-}
\ No newline at end of file
+}
@@ -52,6 +52,123 @@ struct user_zns_device {
     void *_private;
 };
 
+struct ss_io_sched;
+
+/* in-memory copy of a zone descriptor, kept in sync by the FTL on append, finish and reset */
+struct zns_zone_info {
+    // zone start LBA
+    uint64_t slba;
+    // write pointer as last seen (or moved) by the FTL
+    uint64_t wp;
+    // writable capacity of the zone in LBAs
+    uint64_t cap;
+    // zone state, as in the zs field of the zone descriptor (>> 4)
+    uint8_t state;
+};
+
+/* FTL counters, all in LBAs unless noted. Write amplification is (log_write_blocks + direct_write_blocks + gc_write_blocks) / user_write_blocks */
+struct zns_udevice_stats {
+    // blocks the user asked to write
+    uint64_t user_write_blocks;
+    // blocks appended to the log zones
+    uint64_t log_write_blocks;
+    // blocks of sequential runs written straight to their data zone, around the log
+    uint64_t direct_write_blocks;
+    // blocks read and written back by GC merges
+    uint64_t gc_read_blocks;
+    uint64_t gc_write_blocks;
+    // the part of gc_write_blocks the device copied itself (NVMe Copy), without a trip through the host
+    uint64_t gc_copy_blocks;
+    // GC passes, the time they took (us), and the log zones they gave back to the free pool
+    uint64_t gc_runs;
+    uint64_t gc_time_us;
+    uint64_t gc_zones_reclaimed;
+    // logical zones merged by rewriting a whole zone, by filling in the tail of an in-order
+    // log zone, and by taking over an in-order log zone as it is
+    uint64_t full_merges;
+    uint64_t partial_merges;
+    uint64_t switch_merges;
+    // logical zones merged by rewriting only the chunks their log blocks fall into (chunk_blocks), and
+    // chunks moved inside the chunk area to give back a zone of it
+    uint64_t chunk_merges;
+    uint64_t chunk_relocations;
+    // user blocks routed to the hot and the cold log (hot/cold separation)
+    uint64_t hot_write_blocks;
+    uint64_t cold_write_blocks;
+    // live blocks in the log zones GC picked as victims, what the policy chose to move
+    uint64_t gc_victim_blocks;
+    // blocks GC moved along inside the log (age sorting) rather than merging them, part of gc_write_blocks
+    uint64_t gc_relocated_blocks;
+    // blocks the user wrote with a lifetime hint (zns_udevice_write_hint)
+    uint64_t hint_write_blocks;
+    // blocks the user wrote as all zeroes, kept in the map only and never written to the device
+    uint64_t zero_write_blocks;
+    // blocks the user trimmed, and data zones given back because their logical zone was trimmed as a whole
+    uint64_t trim_blocks;
+    uint64_t trim_zones_reclaimed;
+    // user blocks packed into the log compressed, and the log blocks the packing saved
+    uint64_t compress_blocks;
+    uint64_t compress_saved_blocks;
+    // user blocks mapped to a log block with the same content instead of being written, and fingerprint
+    // matches that turned out to be different content
+    uint64_t dedup_write_blocks;
+    uint64_t dedup_collisions;
+    // blocks read back, by the user or by GC, that did not match the checksum they were written with
+    uint64_t checksum_errors;
+    // writes turned away with -EAGAIN because they would have waited for GC (write_nonblock)
+    uint64_t write_backoffs;
+    // data zones moved by static wear leveling, and the fewest and most resets of any zone
+    uint64_t wear_migrations;
+    uint32_t wear_min_resets;
+    uint32_t wear_max_resets;
+};
+
+/* room the log has before writes wait for GC, see zns_udevice_get_space */
+struct zns_udevice_space {
+    // log zones of the budget, the ones still free, and the watermark GC keeps free
+    uint32_t log_zones;
+    uint32_t free_log_zones;
+    uint32_t gc_watermark;
+    // blocks GC expects to copy until it is no longer pressed for room, it grows as the log fills up
+    uint64_t gc_debt_blocks;
+    // at the watermark, how long until GC has made room for a write turned away (us), else 0
+    uint64_t retry_after_us;
+    // blocks going into the log per second lately, and how long the zones above the watermark last at that
+    // rate (us): 0 at the watermark, UINT64_MAX while nothing is written
+    uint64_t ingest_blocks_per_s;
+    uint64_t exhaustion_us;
+};
+
+/* how long the data of a write is expected to live, see zns_udevice_write_hint */
+enum zns_write_hint {
+    ZNS_HINT_NONE = 0,
+    // dies soon, e.g. the WAL
+    ZNS_HINT_SHORT,
+    // e.g. L0 SSTs, rewritten by the next compaction
+    ZNS_HINT_MEDIUM,
+    // e.g. SSTs of the last levels
+    ZNS_HINT_LONG,
+    ZNS_N_HINTS
+};
+
+/* GC victim selection policies, see zdev_init_params */
+enum zns_gc_policy {
+    ZNS_GC_GREEDY = 0,
+    ZNS_GC_COST_BENEFIT,
+    ZNS_GC_AGE_THRESHOLD,
+    ZNS_GC_FIFO,
+    ZNS_GC_N_POLICIES
+};
+
+/* per-block end-to-end checksums (CRC32C), see zdev_init_params */
+enum zns_checksum {
+    ZNS_CHECKSUM_OFF = 0,
+    // kept up to date on writes, not checked
+    ZNS_CHECKSUM_STORE,
+    // also checked on reads and GC copies
+    ZNS_CHECKSUM_VERIFY
+};
+
 struct zns_device_metadata
 {
     // file descriptor of the opened device
@@ -69,23 +186,106 @@ struct zns_device_metadata
     
     // start and end of the log zone and the data zone
     // for m4 perhaps
+    // the log ones count the live (still mapped) log blocks, the zones themselves come from the free pool
     uint32_t log_zone_start, log_zone_end;
     uint32_t data_zone_start, data_zone_end;
     uint32_t n_log_zone;
     
     uint32_t n_blocks_per_zone;
 
-    uint8_t *zone_states;
+    // authoritative mirror of every zone, indexed by zone number
+    struct zns_zone_info *zones;
+    uint32_t n_zones;
+    // the zones this instance uses, [start, end). All of them, unless it is one shard of the device
+    uint32_t shard_zone_start, shard_zone_end;
+    // verify the mirror against a device zone report after every GC pass
+    bool zone_check;
+    // live (still mapped) log blocks per zone, what GC looks at to pick a victim
+    uint32_t *valid_blocks;
+    // per zone, the write clock (log + direct blocks written) when it was last appended to
+    uint64_t *zone_mtime;
+    // how GC picks its victim (enum zns_gc_policy)
+    int gc_policy;
+    // GC age sorting: age buckets in use, and per zone the bucket of the blocks in it (0 = user writes)
+    uint32_t gc_age_buckets;
+    uint8_t *zone_gc_age;
+    // static wear leveling kicks in at this many resets between the least worn data zone and the most worn zone (0 = off)
+    uint32_t wear_gap;
+
+    // hot/cold separation: write temperature is tracked per range of heat_range_blocks LBAs
+    bool hot_cold;
+    uint32_t heat_range_blocks;
+    // the temperature halves every heat_epoch_blocks written blocks
+    uint64_t heat_epoch_blocks;
+    uint64_t heat_writes;
+    uint16_t heat_epoch;
+
+    // a sequential run of this many blocks from a zone start bypasses the log
+    uint32_t seq_run_blocks;
+
+    // data zones are also mapped in chunks of this many blocks (0 = whole zones only), a chunk rewritten on
+    // its own goes to the chunk area of up to chunk_zone_num_config zones
+    uint32_t chunk_blocks;
+    uint32_t chunk_zone_num_config;
+
+    // GC merges copy on the device, with the Copy limits of the namespace (ranges per command,
+    // blocks per range, blocks per command)
+    bool copy_offload;
+    uint32_t copy_max_ranges;
+    uint32_t copy_max_range_blocks;
+    uint32_t copy_max_blocks;
+
+    // all-zero blocks of a write only go to the map
+    bool zero_detect;
+    // log writes of more than one block are compressed and packed back to back
+    bool compress;
+    // log blocks with the same content are stored once
+    bool dedup;
+    // a CRC32C per user block (enum zns_checksum)
+    int checksum;
+    // this is a volume striped over other devices (struct zns_volume), none of the FTL state is set up
+    bool volume;
+
+    struct zns_udevice_stats stats;
+
+    // every device command of the FTL goes through here, queued by its class (see io_sched.h)
+    struct ss_io_sched *io_sched;
 
     int log_zone_num_config;
 
     pthread_mutex_t gc_mutex = PTHREAD_MUTEX_INITIALIZER;
-    pthread_cond_t start_gc = PTHREAD_COND_INITIALIZER;
     pthread_cond_t stop_gc = PTHREAD_COND_INITIALIZER;
 
-    pthread_t gc_thread_id = 0;
-    bool gc_thread_stop = false;
+    // GC runs as tasks on the shared background executor (executor.h): one is queued or running, a
+    // delayed one looks again for background GC, and none is started once gc_stop is set
+    bool gc_scheduled = false;
+    bool gc_timer = false;
+    bool gc_stop = false;
     bool trigger_my_gc = false;
+    // a GC pass is under way, its remaining logical zones are merged one at a time
+    bool gc_pass_open;
+
+    // GC rate control: share of the device I/O for background GC (percent, 0 = GC only when writes block),
+    // how many free log zones above the watermark it starts at, and its token bucket in blocks
+    uint32_t gc_bw_pct;
+    uint32_t gc_slack;
+    // gc_slack is only the start, the slack follows the ingest rate
+    bool gc_adaptive;
+    // a write that would wait for GC fails with -EAGAIN instead
+    bool write_nonblock;
+    double gc_tokens;
+    // foreground commands waiting for the gc_mutex, and when the last one ran (us)
+    uint32_t fg_waiting;
+    uint64_t fg_last_us;
+
+    // background zone reset, guards the free pool and the reset queue
+    pthread_mutex_t reset_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t zone_freed = PTHREAD_COND_INITIALIZER;
+    // a reset task is queued or running on the background executor, none is started once reset_stop is set
+    bool reset_scheduled = false;
+    bool reset_stop = false;
+    // zones taken off the queue that a reset task, or a thread that needed a zone, is still working on
+    uint32_t resets_in_flight;
     // ...
 };
 
@@ -100,15 +300,76 @@ struct zns_device_metadata
 * must be running and cleaning zones. The default value is 1. So when the last 
 * zone is left free (out of the 3), clean up some space from the Log by converting 
 * some mapping from Log to Data.
+* A log zone counts as free until a block is written to it: GC runs when a write would leave fewer than 
+* gc_wmark log zones free, and a write needs at most log_zones - gc_wmark zones of log. 
 * force_reset: If true, then always reset the whole device before using. This is the default behavior. 
 * Changing this come in handy for M5 when using persistency. You do not have to 
 * touch this variable for M2-M3, but implement this behavior to reset the whole device. 
+* zone_check: If true, the in-memory zone mirror is compared against a full zone report 
+* after every GC pass and at deinit, mismatches are printed. Off by default, it costs a report. 
+* hot_cold: If true, writes are classified by how often their LBA range was written recently 
+* and frequently overwritten (hot) data gets its own log zones, apart from the cold data. 
+* copy_offload: If true, GC merges move blocks with the NVMe Copy command when the controller 
+* supports it, instead of reading them to the host and writing them back. 
+* gc_bw_pct: If not 0, GC also runs in the background before the watermark is hit, taking about 
+* this percentage of the device I/O (more as free space runs out). 0 means GC only runs when a write 
+* has to wait for it. 
+* gc_adaptive: if true, background GC starts as early as the rate the log fills at needs: while the free 
+* log zones above the watermark still last, at the peak rate of late, as long as GC takes to give back a 
+* couple of zones. When no foreground I/O comes, GC also cleans ahead up to twice that. With gc_bw_pct 0 
+* GC takes 10%. 
+* io_sched: 0 sends the device commands straight down. 1 queues them per class (user reads, user 
+* writes, zone management, GC) and serves the classes in proportion to io_weights, 2 serves them by 
+* strict priority in that order. Reads or writes queued in one class that continue each other on the 
+* device are merged into one command, appends and zone commands are not. 
+* io_weights: weights of the four classes for io_sched 1, 0 takes the default (8, 4, 2, 1). 
+* gc_policy: how GC picks the log zone to clean (enum zns_gc_policy). Greedy (default) takes the 
+* fewest live blocks, cost-benefit weighs free space by its age against the copy cost, age threshold 
+* is greedy among zones not written for a log's worth of writes, FIFO takes the oldest log zone. 
+* wear_gap: zones are always allocated least worn first. If not 0, GC also moves the data of the 
+* least worn data zone to the most worn free zone once their reset counts are this far apart. 
+* gc_age_buckets: if not 0, GC moves the few live blocks a logical zone has in the victim to GC log 
+* zones sorted by the number of passes they survived (up to 3 buckets), instead of merging the whole 
+* logical zone. Blocks that survive the last bucket are merged. 
+* zero_detect: if true, the all-zero blocks of a write are not written. They only go to the map and read back 
+* as zeroes, as after a trim. Zero blocks that carry on a sequential run are still written, they cost no GC. 
+* compress: if true, the blocks of a log write are compressed (zlib, fastest level) and packed back to 
+* back, a block may straddle two LBAs. Blocks that do not shrink by an eighth are packed as they are. 
+* Reads and GC unpack them, merges write data zones uncompressed. Ignored when the library is built without zlib. 
+* dedup: if true, a block written with the content of a block the log holds (same fingerprint, and the 
+* same bytes when compared) is mapped to that block instead of written. Blocks merged into data zones 
+* are no longer shared. 
+* checksum: ZNS_CHECKSUM_VERIFY keeps a CRC32C of every block as the user wrote it, with the mappings, and 
+* checks it when the block is read (a mismatch fails the read with -EIO) and when GC copies it (GC copies 
+* through the host then, not with NVMe Copy). ZNS_CHECKSUM_STORE only keeps them up to date, so a later 
+* instance can check again, ZNS_CHECKSUM_OFF (default) keeps none. 
+* stripe_blocks: name may list several devices separated by commas, "nvme0n1,nvme1n1". They are opened as 
+* one volume striped over them (RAID-0) in stripes of this many LBAs, 0 takes the default (32). Every 
+* member runs its own FTL with the other parameters, requests that span members run on them in parallel. 
+* shards: if more than 1, the device is split into this many shards with a range of zones each, every shard 
+* an FTL of its own (log_zones log zones, mappings, lock and GC). Logical zones go round robin over the 
+* shards, so writers on different shards never wait for each other. 0 or 1 runs one FTL over the device. 
+* write_nonblock: if true, a write that would have to wait for GC to make room in the log fails with 
+* -EAGAIN instead and GC is started. A write over several logical zones may have written its first 
+* ones by then, the whole write is tried again. zns_udevice_get_space tells when to try, and how far 
+* behind GC is so writers can slow down before they are turned away. 
+* chunk_blocks: if not 0, data zones are also mapped in chunks of this many LBAs (16 to 1024 for 64 KiB to 
+* 4 MiB chunks of 4 KiB LBAs). A merge whose log blocks fall into few chunks of the logical zone writes only 
+* those chunks, to a chunk area of their own, instead of the whole zone. Reads take a chunk from there 
+* until the logical zone is merged as a whole again, which happens once half of it is in chunks. 
+* chunk_zones: zones of the chunk area, they are taken from the capacity. 0 takes log_zones. 
+* bg_threads: worker threads of the executor that runs the GC and zone resets of every FTL instance in the 
+* process, 0 takes the default (2). The first instance that is set up sizes it. 
+* Every option past force_reset is off, or takes its default, when 0: zero the struct (params{}) and set 
+* name, log_zones, gc_wmark, force_reset and what else differs. 
 * Setup: 
 * 0 -------------------------------------------------- total_device_zones |
-* <----- log_zones -------------> <---------- data_zones ------------------------>
+* [ L ][ D ][ D ][   ][ L ][ D ][ L ][   ][ D ] ...  L = log, D = data, empty = in the pre-erased pool 
 * 
-* ^^^ copied-data from the log to convert it into block-mapped 
-* new writes go here page-mapped 
+* log_zones of the zones hold the log: new writes go there page-mapped. The data zones hold what GC 
+* copied out of the log to convert it into block-mapped. Neither has a fixed place, both take their 
+* zones from the pool of pre-erased zones anywhere on the device, and a zone either gives up goes back 
+* to the pool after its reset. So do the zones of the chunk area, with chunk_blocks. 
 *
 * The data zone size would be the capacity exposed to the user for read/write. The log space is used internally by your FTL. With the default values: 
 */
@@ -117,12 +378,42 @@ struct zdev_init_params{
     int log_zones;
     int gc_wmark;
     bool force_reset;
+    bool zone_check;
+    bool hot_cold;
+    bool copy_offload;
+    uint32_t gc_bw_pct;
+    bool gc_adaptive;
+    int io_sched;
+    uint32_t io_weights[4];
+    int gc_policy;
+    uint32_t wear_gap;
+    uint32_t gc_age_buckets;
+    bool zero_detect;
+    bool compress;
+    bool dedup;
+    int checksum;
+    uint32_t stripe_blocks;
+    uint32_t shards;
+    uint32_t bg_threads;
+    bool write_nonblock;
+    uint32_t chunk_blocks;
+    uint32_t chunk_zones;
 };
 
 int init_ss_zns_device(struct zdev_init_params *params, struct user_zns_device **my_dev);
 int zns_udevice_read(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size);
 int zns_udevice_write(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size);
+// a write with a lifetime hint (enum zns_write_hint): the blocks go to log zones of their own hint,
+// so data that dies together sits together. ZNS_HINT_NONE is the same as zns_udevice_write
+int zns_udevice_write_hint(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size, int hint);
+// the range is no longer needed, it reads back as zeroes until written again
+int zns_udevice_trim(struct user_zns_device *my_dev, uint64_t address, uint64_t size);
 int deinit_ss_zns_device(struct user_zns_device *my_dev);
+int zns_udevice_get_stats(struct user_zns_device *my_dev, struct zns_udevice_stats *stats);
+// free log space and GC debt, to pace writes by (see write_nonblock)
+int zns_udevice_get_space(struct user_zns_device *my_dev, struct zns_udevice_space *space);
+// resets of every zone so far, resets has room for n_zones entries. Returns the number of zones
+int zns_udevice_get_wear(struct user_zns_device *my_dev, uint32_t *resets, uint32_t n_zones);
 };
 
 #endif //STOSYS_PROJECT_ZNS_DEVICE_H
\ No newline at end of file
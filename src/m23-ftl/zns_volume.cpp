@@ -0,0 +1,452 @@
+/*
+* MIT License
+Copyright (c) 2021 - current
+Authors: Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "zns_volume.h"
+
+extern "C" {
+
+    enum { ZNS_VOLUME_READ, ZNS_VOLUME_WRITE, ZNS_VOLUME_TRIM };
+
+    // stripe unit when zdev_init_params leaves it at 0
+    static const uint32_t DEFAULT_STRIPE_BLOCKS = 32;
+
+    // the caller sleeps on this until every piece it queued is done
+    struct zns_volume_wait {
+        pthread_cond_t cond;
+        uint32_t pending;
+    };
+
+    // what a request does on one member: one range there, a piece of the user buffer or a bounce buffer
+    struct zns_volume_piece {
+        int op;
+        uint64_t address;
+        uint64_t size;
+        char *buf;
+        int hint;
+        int ret;
+        struct zns_volume_wait *wait;
+        // (offset in the user buffer, bytes) of every stripe of the range, in order
+        std::vector<std::pair<uint64_t, uint64_t>> segments;
+    };
+
+    static int piece_run(struct zns_volume_member *member, struct zns_volume_piece *piece) {
+        switch (piece->op) {
+            case ZNS_VOLUME_READ:
+                return zns_udevice_read(member->dev, piece->address, piece->buf, piece->size);
+            case ZNS_VOLUME_WRITE:
+                return zns_udevice_write_hint(member->dev, piece->address, piece->buf, piece->size, piece->hint);
+            default:
+                return zns_udevice_trim(member->dev, piece->address, piece->size);
+        }
+    }
+
+    static void *member_worker(void *args) {
+        struct zns_volume_member *member = (struct zns_volume_member *)args;
+        struct zns_volume *volume = member->volume;
+        pthread_mutex_lock(&volume->lock);
+        while (true) {
+            if (member->queue.empty()) {
+                if (volume->stop) {
+                    break;
+                }
+                pthread_cond_wait(&member->work, &volume->lock);
+                continue;
+            }
+            struct zns_volume_piece *piece = member->queue.front();
+            member->queue.pop_front();
+            pthread_mutex_unlock(&volume->lock);
+            int ret = piece_run(member, piece);
+            pthread_mutex_lock(&volume->lock);
+            piece->ret = ret;
+            if (--piece->wait->pending == 0) {
+                pthread_cond_signal(&piece->wait->cond);
+            }
+        }
+        pthread_mutex_unlock(&volume->lock);
+        return (void *)0;
+    }
+
+    // cut [address, address + size) at the stripes into one piece per member, pieces[m].size is 0 for
+    // the members it does not touch
+    static void volume_split(struct zns_volume *volume, uint32_t lba_size, int op, uint64_t address, uint64_t size,
+                             std::vector<struct zns_volume_piece> &pieces) {
+        uint64_t stripe_bytes = (uint64_t)volume->stripe_blocks * lba_size;
+        uint64_t n = volume->members.size();
+        pieces.resize(n);
+        for (uint64_t off = 0; off < size;) {
+            uint64_t stripe = (address + off) / stripe_bytes, in = (address + off) % stripe_bytes;
+            uint64_t len = std::min(stripe_bytes - in, size - off);
+            struct zns_volume_piece &piece = pieces[stripe % n];
+            if (piece.size == 0) {
+                piece.op = op;
+                piece.address = (stripe / n) * stripe_bytes + in;
+            }
+            piece.size += len;
+            if (op != ZNS_VOLUME_TRIM) {
+                piece.segments.emplace_back(off, len);
+            }
+            off += len;
+        }
+    }
+
+    // run the pieces, the first one in the caller and the others on the workers of their members.
+    // Returns the first error
+    static int volume_submit(struct zns_volume *volume, std::vector<struct zns_volume_piece> &pieces) {
+        struct zns_volume_wait wait{};
+        int inline_piece = -1;
+        for (size_t m = 0; m < pieces.size(); m++) {
+            if (pieces[m].size != 0) {
+                if (inline_piece == -1) {
+                    inline_piece = m;
+                } else {
+                    wait.pending++;
+                }
+            }
+        }
+        if (inline_piece == -1) {
+            return 0;
+        }
+        if (wait.pending > 0) {
+            pthread_cond_init(&wait.cond, NULL);
+            pthread_mutex_lock(&volume->lock);
+            for (size_t m = inline_piece + 1; m < pieces.size(); m++) {
+                if (pieces[m].size != 0) {
+                    pieces[m].wait = &wait;
+                    volume->members[m].queue.push_back(&pieces[m]);
+                    pthread_cond_signal(&volume->members[m].work);
+                }
+            }
+            pthread_mutex_unlock(&volume->lock);
+        }
+        int ret = piece_run(&volume->members[inline_piece], &pieces[inline_piece]);
+        if (wait.pending > 0) {
+            pthread_mutex_lock(&volume->lock);
+            while (wait.pending > 0) {
+                pthread_cond_wait(&wait.cond, &volume->lock);
+            }
+            pthread_mutex_unlock(&volume->lock);
+            pthread_cond_destroy(&wait.cond);
+        }
+        for (size_t m = 0; m < pieces.size() && ret == 0; m++) {
+            ret = pieces[m].ret;
+        }
+        return ret;
+    }
+
+    // a read or write of the user buffer: a member that gets one stripe works on the user buffer directly,
+    // one that gets several on a bounce buffer holding them back to back
+    static int volume_rw(struct user_zns_device *my_dev, int op, uint64_t address, void *buffer, uint32_t size, int hint) {
+        if (size % my_dev->lba_size_bytes) {
+            printf("INVALID: %s size not aligned to block size\n", op == ZNS_VOLUME_READ ? "read" : "write");
+            return -EINVAL;
+        }
+        if (address + size > my_dev->capacity_bytes) {
+            printf("INVALID: %s of %u bytes at 0x%lx is beyond the volume capacity\n", op == ZNS_VOLUME_READ ? "read" : "write",
+                   size, address);
+            return -EINVAL;
+        }
+        struct zns_volume *volume = static_cast<struct zns_volume *>((struct zns_device_metadata *)my_dev->_private);
+        char *user = (char *)buffer;
+        std::vector<struct zns_volume_piece> pieces;
+        volume_split(volume, my_dev->lba_size_bytes, op, address, size, pieces);
+        int ret = 0;
+        for (auto &piece : pieces) {
+            piece.hint = hint;
+            if (piece.segments.size() == 1) {
+                piece.buf = user + piece.segments[0].first;
+            } else if (piece.segments.size() > 1) {
+                piece.buf = (char *)malloc(piece.size);
+                if (piece.buf == nullptr) {
+                    ret = -ENOMEM;
+                    continue;
+                }
+                if (op == ZNS_VOLUME_WRITE) {
+                    uint64_t off = 0;
+                    for (auto &segment : piece.segments) {
+                        memcpy(piece.buf + off, user + segment.first, segment.second);
+                        off += segment.second;
+                    }
+                }
+            }
+        }
+        if (ret == 0) {
+            ret = volume_submit(volume, pieces);
+        }
+        for (auto &piece : pieces) {
+            if (piece.segments.size() <= 1 || piece.buf == nullptr) {
+                continue;
+            }
+            if (op == ZNS_VOLUME_READ && ret == 0) {
+                uint64_t off = 0;
+                for (auto &segment : piece.segments) {
+                    memcpy(user + segment.first, piece.buf + off, segment.second);
+                    off += segment.second;
+                }
+            }
+            free(piece.buf);
+        }
+        return ret;
+    }
+
+    int zns_volume_read(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size) {
+        return volume_rw(my_dev, ZNS_VOLUME_READ, address, buffer, size, ZNS_HINT_NONE);
+    }
+
+    int zns_volume_write(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size, int hint) {
+        return volume_rw(my_dev, ZNS_VOLUME_WRITE, address, buffer, size, hint);
+    }
+
+    int zns_volume_trim(struct user_zns_device *my_dev, uint64_t address, uint64_t size) {
+        if (address % my_dev->lba_size_bytes || size % my_dev->lba_size_bytes) {
+            printf("INVALID: trim not aligned to block size\n");
+            return -EINVAL;
+        }
+        if (address + size > my_dev->capacity_bytes) {
+            printf("INVALID: trim of %lu bytes at 0x%lx is beyond the volume capacity\n", size, address);
+            return -EINVAL;
+        }
+        struct zns_volume *volume = static_cast<struct zns_volume *>((struct zns_device_metadata *)my_dev->_private);
+        std::vector<struct zns_volume_piece> pieces;
+        volume_split(volume, my_dev->lba_size_bytes, ZNS_VOLUME_TRIM, address, size, pieces);
+        return volume_submit(volume, pieces);
+    }
+
+    // stops the workers and closes the members, returns the first error
+    static int volume_close(struct zns_volume *volume) {
+        pthread_mutex_lock(&volume->lock);
+        volume->stop = true;
+        for (auto &member : volume->members) {
+            pthread_cond_signal(&member.work);
+        }
+        pthread_mutex_unlock(&volume->lock);
+        int ret = 0;
+        for (auto &member : volume->members) {
+            if (member.thread != 0) {
+                pthread_join(member.thread, NULL);
+            }
+            pthread_cond_destroy(&member.work);
+            if (member.dev != nullptr) {
+                int dret = deinit_ss_zns_device(member.dev);
+                ret = ret != 0 ? ret : dret;
+            }
+        }
+        pthread_mutex_destroy(&volume->lock);
+        delete volume;
+        return ret;
+    }
+
+    int zns_volume_init(struct zdev_init_params *params, struct user_zns_device **my_dev) {
+        auto *volume = new zns_volume();
+        volume->volume = true;
+        volume->stripe_blocks = params->stripe_blocks != 0 ? params->stripe_blocks : DEFAULT_STRIPE_BLOCKS;
+        pthread_mutex_init(&volume->lock, NULL);
+        // several devices are striped first, each of them is sharded on its own
+        volume->sharded = strchr(params->name, ',') == nullptr;
+        for (uint32_t s = 0; volume->sharded && s < params->shards; s++) {
+            volume->names.emplace_back(params->name);
+        }
+        for (const char *name = params->name; !volume->sharded; ) {
+            const char *comma = strchr(name, ',');
+            volume->names.emplace_back(name, comma != nullptr ? comma - name : strlen(name));
+            if (comma == nullptr) {
+                break;
+            }
+            name = comma + 1;
+        }
+        // the members never move once their workers run
+        volume->members.resize(volume->names.size());
+        for (auto &member : volume->members) {
+            member.volume = volume;
+            pthread_cond_init(&member.work, NULL);
+        }
+
+        int ret = 0;
+        struct zdev_init_params member_params = *params;
+        for (size_t m = 0; m < volume->members.size() && ret == 0; m++) {
+            member_params.name = (char *)volume->names[m].c_str();
+            if (volume->sharded) {
+                ret = init_ss_zns_shard(&member_params, &volume->members[m].dev, m, volume->members.size());
+            } else {
+                ret = init_ss_zns_device(&member_params, &volume->members[m].dev);
+            }
+            if (ret != 0) {
+                printf("[ERROR] FAILED TO OPEN VOLUME MEMBER %s: %d\n", member_params.name, ret);
+                volume->members[m].dev = nullptr;
+            }
+        }
+        uint32_t lba_size = ret == 0 ? volume->members[0].dev->lba_size_bytes : 0;
+        if (ret == 0 && volume->sharded) {
+            volume->stripe_blocks = volume->members[0].dev->tparams.zns_zone_capacity / lba_size;
+        }
+        uint64_t member_capacity = UINT64_MAX;
+        for (auto &member : volume->members) {
+            if (ret != 0) {
+                break;
+            }
+            if (member.dev->lba_size_bytes != lba_size) {
+                printf("[ERROR] VOLUME MEMBERS HAVE DIFFERENT LBA SIZES: %u and %u\n", lba_size, member.dev->lba_size_bytes);
+                ret = -EINVAL;
+            }
+            // only whole stripes, and as many on every member
+            uint64_t stripe_bytes = (uint64_t)volume->stripe_blocks * lba_size;
+            member_capacity = std::min(member_capacity, member.dev->capacity_bytes / stripe_bytes * stripe_bytes);
+        }
+        if (ret == 0 && member_capacity == 0) {
+            printf("[ERROR] A STRIPE OF %u BLOCKS IS LARGER THAN A VOLUME MEMBER\n", volume->stripe_blocks);
+            ret = -EINVAL;
+        }
+        for (size_t m = 0; m < volume->members.size() && ret == 0; m++) {
+            ret = pthread_create(&volume->members[m].thread, NULL, &member_worker, &volume->members[m]);
+            if (ret) {
+                printf("[ERROR] FAILED TO CREATE VOLUME WORKER: %d\n", ret);
+                volume->members[m].thread = 0;
+            }
+        }
+        if (ret != 0) {
+            volume_close(volume);
+            return ret;
+        }
+
+        (*my_dev) = static_cast<struct user_zns_device *>(calloc(sizeof(struct user_zns_device), 1));
+        (*my_dev)->lba_size_bytes = lba_size;
+        (*my_dev)->capacity_bytes = member_capacity * volume->members.size();
+        (*my_dev)->tparams = volume->members[0].dev->tparams;
+        for (size_t m = 1; m < volume->members.size() && !volume->sharded; m++) {
+            (*my_dev)->tparams.zns_num_zones += volume->members[m].dev->tparams.zns_num_zones;
+        }
+        (*my_dev)->_private = static_cast<struct zns_device_metadata *>(volume);
+        printf("[stosys] %s of %zu %s, stripe %u blocks, capacity %lu bytes\n", volume->sharded ? "sharded FTL" : "volume",
+               volume->members.size(), volume->sharded ? "shards" : "devices", volume->stripe_blocks, (*my_dev)->capacity_bytes);
+        return 0;
+    }
+
+    int zns_volume_deinit(struct user_zns_device *my_dev) {
+        int ret = volume_close(static_cast<struct zns_volume *>((struct zns_device_metadata *)my_dev->_private));
+        free(my_dev);
+        return ret;
+    }
+
+    int zns_volume_get_stats(struct user_zns_device *my_dev, struct zns_udevice_stats *stats) {
+        struct zns_volume *volume = static_cast<struct zns_volume *>((struct zns_device_metadata *)my_dev->_private);
+        memset(stats, 0, sizeof(*stats));
+        stats->wear_min_resets = UINT32_MAX;
+        for (auto &member : volume->members) {
+            struct zns_udevice_stats s{};
+            int ret = zns_udevice_get_stats(member.dev, &s);
+            if (ret != 0) {
+                return ret;
+            }
+            stats->user_write_blocks += s.user_write_blocks;
+            stats->log_write_blocks += s.log_write_blocks;
+            stats->direct_write_blocks += s.direct_write_blocks;
+            stats->gc_read_blocks += s.gc_read_blocks;
+            stats->gc_write_blocks += s.gc_write_blocks;
+            stats->gc_copy_blocks += s.gc_copy_blocks;
+            stats->gc_runs += s.gc_runs;
+            stats->gc_time_us += s.gc_time_us;
+            stats->gc_zones_reclaimed += s.gc_zones_reclaimed;
+            stats->full_merges += s.full_merges;
+            stats->partial_merges += s.partial_merges;
+            stats->switch_merges += s.switch_merges;
+            stats->chunk_merges += s.chunk_merges;
+            stats->chunk_relocations += s.chunk_relocations;
+            stats->hot_write_blocks += s.hot_write_blocks;
+            stats->cold_write_blocks += s.cold_write_blocks;
+            stats->gc_victim_blocks += s.gc_victim_blocks;
+            stats->gc_relocated_blocks += s.gc_relocated_blocks;
+            stats->hint_write_blocks += s.hint_write_blocks;
+            stats->zero_write_blocks += s.zero_write_blocks;
+            stats->trim_blocks += s.trim_blocks;
+            stats->trim_zones_reclaimed += s.trim_zones_reclaimed;
+            stats->compress_blocks += s.compress_blocks;
+            stats->compress_saved_blocks += s.compress_saved_blocks;
+            stats->dedup_write_blocks += s.dedup_write_blocks;
+            stats->dedup_collisions += s.dedup_collisions;
+            stats->checksum_errors += s.checksum_errors;
+            stats->write_backoffs += s.write_backoffs;
+            stats->wear_migrations += s.wear_migrations;
+            stats->wear_min_resets = std::min(stats->wear_min_resets, s.wear_min_resets);
+            stats->wear_max_resets = std::max(stats->wear_max_resets, s.wear_max_resets);
+        }
+        return 0;
+    }
+
+    int zns_volume_get_space(struct user_zns_device *my_dev, struct zns_udevice_space *space) {
+        struct zns_volume *volume = static_cast<struct zns_volume *>((struct zns_device_metadata *)my_dev->_private);
+        memset(space, 0, sizeof(*space));
+        space->exhaustion_us = UINT64_MAX;
+        // a write may go to any member, it waits for the one furthest behind
+        for (auto &member : volume->members) {
+            struct zns_udevice_space s{};
+            int ret = zns_udevice_get_space(member.dev, &s);
+            if (ret != 0) {
+                return ret;
+            }
+            space->log_zones += s.log_zones;
+            space->free_log_zones += s.free_log_zones;
+            space->gc_watermark += s.gc_watermark;
+            space->gc_debt_blocks += s.gc_debt_blocks;
+            space->retry_after_us = std::max(space->retry_after_us, s.retry_after_us);
+            space->ingest_blocks_per_s += s.ingest_blocks_per_s;
+            space->exhaustion_us = std::min(space->exhaustion_us, s.exhaustion_us);
+        }
+        return 0;
+    }
+
+    int zns_volume_get_wear(struct user_zns_device *my_dev, uint32_t *resets, uint32_t n_zones) {
+        struct zns_volume *volume = static_cast<struct zns_volume *>((struct zns_device_metadata *)my_dev->_private);
+        if (n_zones < my_dev->tparams.zns_num_zones) {
+            return -EINVAL;
+        }
+        uint32_t done = 0;
+        if (volume->sharded) {
+            // every shard counts the zones it owns, the others stay 0
+            std::vector<uint32_t> shard_resets(n_zones);
+            memset(resets, 0, n_zones * sizeof(uint32_t));
+            for (auto &member : volume->members) {
+                int ret = zns_udevice_get_wear(member.dev, shard_resets.data(), n_zones);
+                if (ret < 0) {
+                    return ret;
+                }
+                for (int i = 0; i < ret; i++) {
+                    resets[i] += shard_resets[i];
+                }
+                done = ret;
+            }
+            return done;
+        }
+        for (auto &member : volume->members) {
+            int ret = zns_udevice_get_wear(member.dev, resets + done, n_zones - done);
+            if (ret < 0) {
+                return ret;
+            }
+            done += ret;
+        }
+        return done;
+    }
+}
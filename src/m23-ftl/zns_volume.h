@@ -0,0 +1,84 @@
+/*
+* MIT License
+Copyright (c) 2021 - current
+Authors: Animesh Trivedi
+This code is part of the Storage System Course at VU Amsterdam
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef STOSYS_PROJECT_ZNS_VOLUME_H
+#define STOSYS_PROJECT_ZNS_VOLUME_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+#include "zns_device.h"
+
+extern "C" {
+/*
+ * A volume striped (RAID-0) over several ZNS devices, made when zdev_init_params names more than one.
+ * Every member runs an FTL of its own. The volume address space is cut into stripes of stripe_blocks
+ * LBAs that go round robin over the members, stripe k is stripe k / n of member k % n, so what a request
+ * covers on one member is a single range there. A request that touches several members is split per
+ * member and the pieces run in parallel, each member has a worker thread, the caller runs one piece
+ * itself. GC runs in every member on its own, as it does for a single device.
+ * A sharded FTL is a volume too, its members are the shards of one device and a stripe is a logical zone.
+ */
+struct zns_volume_piece;
+
+struct zns_volume_member {
+    struct user_zns_device *dev;
+    struct zns_volume *volume;
+    pthread_t thread;
+    pthread_cond_t work;
+    std::deque<struct zns_volume_piece *> queue;
+};
+
+struct zns_volume : zns_device_metadata {
+    std::vector<std::string> names;
+    std::vector<struct zns_volume_member> members;
+    uint32_t stripe_blocks;
+    // the members are the shards of one device
+    bool sharded;
+    // guards the member queues
+    pthread_mutex_t lock;
+    bool stop;
+};
+
+static inline bool zns_volume_is(struct user_zns_device *my_dev) {
+    return ((struct zns_device_metadata *)my_dev->_private)->volume;
+}
+
+int zns_volume_init(struct zdev_init_params *params, struct user_zns_device **my_dev);
+// in zns_device.cpp, the FTL of one shard of a device
+int init_ss_zns_shard(struct zdev_init_params *params, struct user_zns_device **my_dev, uint32_t shard, uint32_t n_shards);
+int zns_volume_deinit(struct user_zns_device *my_dev);
+int zns_volume_read(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size);
+int zns_volume_write(struct user_zns_device *my_dev, uint64_t address, void *buffer, uint32_t size, int hint);
+int zns_volume_trim(struct user_zns_device *my_dev, uint64_t address, uint64_t size);
+// the counters of all members added up, the wear range over all of them
+int zns_volume_get_stats(struct user_zns_device *my_dev, struct zns_udevice_stats *stats);
+// the space of all members added up, the longest retry of any and the first to run out
+int zns_volume_get_space(struct user_zns_device *my_dev, struct zns_udevice_space *space);
+// the resets of the zones of every member, one member after the other, or of the device for shards
+int zns_volume_get_wear(struct user_zns_device *my_dev, uint32_t *resets, uint32_t n_zones);
+}
+
+#endif //STOSYS_PROJECT_ZNS_VOLUME_H